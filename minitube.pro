@@ -46,7 +46,12 @@ HEADERS += src/MainWindow.h \
     src/fontutils.h \
     src/thlibrary/thblackbar.h \
     src/globalshortcuts.h \
-    src/globalshortcutbackend.h
+    src/globalshortcutbackend.h \
+    src/thumbnailstore.h \
+    src/searchcache.h \
+    src/bandwidthestimator.h \
+    src/startuptrace.h \
+    src/playbacklatency.h
 SOURCES += src/main.cpp \
     src/MainWindow.cpp \
     src/SearchView.cpp \
@@ -79,7 +84,12 @@ SOURCES += src/main.cpp \
     src/fontutils.cpp \
     src/thlibrary/thblackbar.cpp \
     src/globalshortcuts.cpp \
-    src/globalshortcutbackend.cpp
+    src/globalshortcutbackend.cpp \
+    src/thumbnailstore.cpp \
+    src/searchcache.cpp \
+    src/bandwidthestimator.cpp \
+    src/startuptrace.cpp \
+    src/playbacklatency.cpp
 RESOURCES += resources.qrc
 DESTDIR = build/target/
 OBJECTS_DIR = build/obj/
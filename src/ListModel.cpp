@@ -1,12 +1,21 @@
 #include "ListModel.h"
 #include "videomimedata.h"
 #include "youtubeinforeader.h"
+#include "searchcache.h"
+#include <algorithm>
+
+namespace The {
+    SearchCache* searchCache();
+}
 
-#define MAX_ITEMS 10
 static const QString recentKeywordsKey = "recentKeywords";
+// the gdata API won't return more than this per request
+static const int MAX_PAGE_SIZE = 50;
 
 ListModel::ListModel(QWidget *parent) : QAbstractListModel(parent) {
     youtubeSearch = 0;
+    prefetchSearch = 0;
+    prefetched = false;
     searching = false;
     canSearchMore = true;
     m_activeVideo = 0;
@@ -14,17 +23,41 @@ ListModel::ListModel(QWidget *parent) : QAbstractListModel(parent) {
     skip = 1;
     searchParams = 0;
     justPastedVideo = false;
+
+    QSettings settings;
+    pageSize = qBound(1, settings.value("pageSize", 10).toInt(), MAX_PAGE_SIZE);
+    fetchSize = pageSize;
+    searchPages = qMax(1, settings.value("searchPages", 1).toInt());
+
+    // long continuous play sessions must not grow without bound
+    compactDistance = qMax(1, settings.value("playlistCompactDistance", 20).toInt());
+    historySize = qMax(0, settings.value("playlistHistorySize", 0).toInt());
+    compactedRows = 0;
+    recordsMemory = 0;
+
+    // thumbnails arrive in bursts, repaint at most once per frame
+    dataChangedTimer = new QTimer(this);
+    dataChangedTimer->setSingleShot(true);
+    dataChangedTimer->setInterval(16);
+    connect(dataChangedTimer, SIGNAL(timeout()), SLOT(emitDataChanged()));
+
+    // a zero interval timer fires whenever the event loop is idle
+    discardTimer = new QTimer(this);
+    discardTimer->setInterval(0);
+    connect(discardTimer, SIGNAL(timeout()), SLOT(deleteDiscardedVideos()));
 }
 
 ListModel::~ListModel() {
     delete youtubeSearch;
+    delete prefetchSearch;
+    qDeleteAll(discardedVideos);
 }
 
 int ListModel::rowCount(const QModelIndex &/*parent*/) const {
-    int count = videos.size();
+    int count = entries.size();
     
     // add the message item
-    if (videos.isEmpty() || !searching)
+    if (entries.isEmpty() || !searching)
         count++;
     
     return count;
@@ -34,7 +67,7 @@ QVariant ListModel::data(const QModelIndex &index, int role) const {
     
     int row = index.row();
     
-    if (row == videos.size()) {
+    if (row == entries.size()) {
         
         QPalette palette;
         QFont boldFont;
@@ -43,12 +76,16 @@ QVariant ListModel::data(const QModelIndex &index, int role) const {
         switch (role) {
         case ItemTypeRole:
             return ItemTypeShowMore;
-        case Qt::DisplayRole:
         case Qt::StatusTipRole:
+            if (errorMessage.isEmpty() && !searching)
+                return tr("%1 videos, %2 KB in memory")
+                        .arg(entries.size()).arg(memoryUsage() / 1024);
+            // fall through
+        case Qt::DisplayRole:
             if (!errorMessage.isEmpty()) return errorMessage;
             if (searching) return tr("Searching...");
-            if (canSearchMore) return tr("Show %1 More").arg(MAX_ITEMS);
-            if (videos.isEmpty()) return tr("No videos");
+            if (canSearchMore) return tr("Show %1 More").arg(fetchSize);
+            if (entries.isEmpty()) return tr("No videos");
             else return tr("No more videos");
         case Qt::TextAlignmentRole:
             return QVariant(int(Qt::AlignHCenter | Qt::AlignVCenter));
@@ -68,21 +105,21 @@ QVariant ListModel::data(const QModelIndex &index, int role) const {
             return QVariant();
         }
         
-    } else if (row < 0 || row >= videos.size())
+    } else if (row < 0 || row >= entries.size())
         return QVariant();
     
-    Video *video = videos.at(row);
+    const Entry &entry = entries.at(row);
     
     switch (role) {
     case ItemTypeRole:
         return ItemTypeVideo;
     case VideoRole:
-        return QVariant::fromValue(QPointer<Video>(video));
+        return QVariant::fromValue(QPointer<Video>(videoAt(row)));
     case ActiveTrackRole:
-        return video == m_activeVideo;
+        return m_activeVideo && entry.video == m_activeVideo;
     case Qt::DisplayRole:
     case Qt::StatusTipRole:
-        return video->title();
+        return entry.video ? entry.video->title() : entry.record.title;
         /*
         case Qt::ToolTipRole:
           
@@ -124,6 +161,14 @@ void ListModel::setActiveRow( int row) {
         
         emit dataChanged( createIndex( m_activeRow, 0 ), createIndex( m_activeRow, columnCount() - 1 ) );
         emit activeRowChanged(row);
+
+        // release what the rows we have left behind are holding,
+        // the ones before compactedRows already did and released ones have nothing left
+        for (int i = compactedRows; i <= row - compactDistance; ++i)
+            if (entries.at(i).video) entries.at(i).video->compact();
+        compactedRows = qMax(compactedRows, row - compactDistance + 1);
+        if (historySize > 0 && row > historySize)
+            QTimer::singleShot(0, this, SLOT(trimHistory()));
         
     } else {
         m_activeRow = -1;
@@ -140,9 +185,39 @@ int ListModel::nextRow() const {
 }
 
 Video* ListModel::videoAt( int row ) const {
-    if ( rowExists( row ) )
-        return videos.at( row );
-    return 0;
+    if ( !rowExists( row ) ) return 0;
+    Entry &entry = entries[row];
+    if (!entry.video) {
+        // scrolled back into view or about to be played
+        entry.video = Video::fromRecord(entry.record);
+        recordsMemory -= entry.record.memoryUsage();
+        entry.record = VideoRecord();
+        videoRows.insert(entry.video, row);
+        connect(entry.video, SIGNAL(gotThumbnail()), SLOT(updateThumbnail()));
+    }
+    return entry.video;
+}
+
+void ListModel::releaseVideos(int firstRow, int lastRow) {
+    // only the live videos are walked, not the whole list
+    const int next = nextRow();
+    QList<int> rows;
+    QHash<Video*, int>::const_iterator it;
+    for (it = videoRows.constBegin(); it != videoRows.constEnd(); ++it) {
+        const int row = it.value();
+        if (row >= firstRow && row <= lastRow) continue;
+        if (it.key() == m_activeVideo || row == next) continue;
+        rows << row;
+    }
+
+    foreach (int row, rows) {
+        Entry &entry = entries[row];
+        entry.record = entry.video->record();
+        recordsMemory += entry.record.memoryUsage();
+        videoRows.remove(entry.video);
+        discardVideo(entry.video);
+        entry.video = 0;
+    }
 }
 
 Video* ListModel::activeVideo() const {
@@ -156,8 +231,7 @@ void ListModel::search(SearchParams *searchParams) {
     }
 
     // delete current videos
-    while (!videos.isEmpty())
-        delete videos.takeFirst();
+    clearVideos();
     m_activeVideo = 0;
     m_activeRow = -1;
     skip = 1;
@@ -167,19 +241,69 @@ void ListModel::search(SearchParams *searchParams) {
     // (re)initialize the YouTubeSearch
     if (youtubeSearch) delete youtubeSearch;
     youtubeSearch = new YouTubeSearch();
-    connect(youtubeSearch, SIGNAL(gotVideo(Video*)), this, SLOT(addVideo(Video*)));
+    connect(youtubeSearch, SIGNAL(gotVideos(QList<Video*>)), this, SLOT(addVideos(QList<Video*>)));
     connect(youtubeSearch, SIGNAL(finished(int)), this, SLOT(searchFinished(int)));
     connect(youtubeSearch, SIGNAL(error(QString)), this, SLOT(searchError(QString)));
 
     this->searchParams = searchParams;
     searching = true;
-    youtubeSearch->search(searchParams, MAX_ITEMS, skip);
-    skip += MAX_ITEMS;
+    prefetched = false;
+    fetchSize = pageSize;
+    searchTime.start();
+    // the pages are requested in parallel and merged in order by YouTubeSearch
+    for (int i = 0; i < searchPages; ++i) {
+        youtubeSearch->search(searchParams, pageSize, skip);
+        skip += pageSize;
+    }
+}
+
+void ListModel::prefetchSortOrders() {
+    if (prefetched || !searchParams || searchParams->keywords().isEmpty()) return;
+    prefetched = true;
+
+    // a separate YouTubeSearch, so that a new search does not cancel these
+    if (!prefetchSearch) prefetchSearch = new YouTubeSearch();
+    for (int sortBy = SearchParams::SortByRelevance; sortBy <= SearchParams::SortByViewCount; ++sortBy) {
+        if (sortBy != searchParams->sortBy())
+            prefetchSearch->prefetch(searchParams->keywords(), sortBy, pageSize, 1);
+    }
+}
+
+void ListModel::trimHistory() {
+    if (historySize <= 0 || m_activeRow <= historySize) return;
+
+    const int count = m_activeRow - historySize;
+    qDebug() << "Removing" << count << "played videos from the playlist";
+    beginRemoveRows(QModelIndex(), 0, count - 1);
+    for (int i = 0; i < count; ++i) {
+        // keep its id in videoIds, so it does not come back with a later page
+        const Entry entry = entries.takeFirst();
+        if (entry.video) {
+            videoRows.remove(entry.video);
+            discardVideo(entry.video);
+        } else recordsMemory -= entry.record.memoryUsage();
+    }
+    m_activeRow -= count;
+    compactedRows = qMax(0, compactedRows - count);
+    shiftVideoRows(count, -count);
+    endRemoveRows();
+}
+
+qint64 ListModel::memoryUsage() const {
+    // the records are counted as they come and go, only the live videos are walked
+    qint64 usage = recordsMemory + entries.size() * sizeof(Entry);
+    QHash<Video*, int>::const_iterator it;
+    for (it = videoRows.constBegin(); it != videoRows.constEnd(); ++it)
+        usage += it.key()->memoryUsage();
+    return usage;
 }
 
 void ListModel::parseClipboard(SearchParams *searchParams) {
-    while (!videos.isEmpty())
-        delete videos.takeFirst();
+    parseUrl(searchParams, QApplication::clipboard()->text());
+}
+
+void ListModel::parseUrl(SearchParams *searchParams, const QString &url) {
+    clearVideos();
     m_activeVideo = 0;
     m_activeRow = -1;
     skip = 1;
@@ -191,7 +315,7 @@ void ListModel::parseClipboard(SearchParams *searchParams) {
     // parse video data and add the pasted video to the top
     Video *video = new Video();
 
-    video->setWebpage(QUrl(QApplication::clipboard()->text()));
+    video->setWebpage(QUrl(url));
     // FIXME malformed clipboard?
     //video->setWebpage(QUrl(QString("http://www.youtube.com/watch?v=qrsuiD2y3c0")));
     YouTubeInfoReader *info = new YouTubeInfoReader();
@@ -199,11 +323,34 @@ void ListModel::parseClipboard(SearchParams *searchParams) {
     info->readInfoAbout(video);
 }
 
+bool ListModel::enqueueUrl(const QString &url) {
+    Video *video = new Video();
+    video->setWebpage(QUrl(url));
+    if (video->id().isEmpty()) {
+        delete video;
+        return false;
+    }
+
+    // appended when title and thumbnails are known
+    YouTubeInfoReader *info = new YouTubeInfoReader();
+    connect(info, SIGNAL(infoRead(Video*)), this, SLOT(enqueueVideo(Video*)));
+    info->readInfoAbout(video);
+    return true;
+}
+
+void ListModel::enqueueVideo(Video *video) {
+    // addVideo() deletes duplicates
+    const QString title = video->title();
+    const bool added = !videoIds.contains(video->id());
+    addVideo(video);
+    emit videoEnqueued(title, added);
+}
+
 void ListModel::infoRead(Video *video) {
     // create a youtube search using the title of the pasted video
     if (youtubeSearch) delete youtubeSearch;
     youtubeSearch = new YouTubeSearch();
-    connect(youtubeSearch, SIGNAL(gotVideo(Video*)), this, SLOT(addVideo(Video*)));
+    connect(youtubeSearch, SIGNAL(gotVideos(QList<Video*>)), this, SLOT(addVideos(QList<Video*>)));
     connect(youtubeSearch, SIGNAL(finished(int)), this, SLOT(searchFinished(int)));
     connect(youtubeSearch, SIGNAL(error(QString)), this, SLOT(searchError(QString)));
 
@@ -222,24 +369,39 @@ void ListModel::searchMore(int max) {
     if (searching) return;
     searching = true;
     errorMessage.clear();
+    searchTime.start();
     youtubeSearch->search(searchParams, max, skip);
     skip += max;
 }
 
 void ListModel::searchMore() {
-    searchMore(MAX_ITEMS);
+    searchMore(fetchSize);
+}
+
+bool ListModel::canFetchMore(const QModelIndex &parent) const {
+    // don't keep hammering the server after an error
+    return !parent.isValid()
+            && youtubeSearch
+            && !entries.isEmpty()
+            && !searching
+            && canSearchMore
+            && errorMessage.isEmpty();
+}
+
+void ListModel::fetchMore(const QModelIndex &parent) {
+    if (!canFetchMore(parent)) return;
+    searchMore();
 }
 
 void ListModel::searchNeeded() {
-    int remainingRows = videos.size() - m_activeRow;
-    int rowsNeeded = MAX_ITEMS - remainingRows;
+    int remainingRows = entries.size() - m_activeRow;
+    int rowsNeeded = pageSize - remainingRows;
     if (rowsNeeded > 0)
         searchMore(rowsNeeded);
 }
 
 void ListModel::abortSearch() {
-    while (!videos.isEmpty())
-        delete videos.takeFirst();
+    clearVideos();
     reset();
     youtubeSearch->abort();
     searching = false;
@@ -249,36 +411,69 @@ void ListModel::searchFinished(int total) {
     searching = false;
     canSearchMore = total > 0;
 
-    qDebug() << "emitting dataChanged";
-    // update the message item
-    emit dataChanged( createIndex( MAX_ITEMS, 0 ), createIndex( MAX_ITEMS, columnCount() - 1 ) );
+    // When requests are slow, fewer and bigger pages amortize the round trip.
+    // When they're fast, go back to the configured size.
+    if (searchTime.isValid()) {
+        const int latency = searchTime.elapsed();
+        if (latency > 2000)
+            fetchSize = qMin(fetchSize * 2, MAX_PAGE_SIZE);
+        else if (latency < 500)
+            fetchSize = qMax(fetchSize / 2, pageSize);
+        searchTime = QTime();
+    }
 
-    qDebug() << "emitting went fine";
+    // update the message item
+    emit dataChanged( createIndex( entries.size(), 0 ), createIndex( entries.size(), columnCount() - 1 ) );
 }
 
 void ListModel::searchError(QString message) {
     errorMessage = message;
+    searchTime = QTime();
     // update the message item
-    emit dataChanged( createIndex( MAX_ITEMS, 0 ), createIndex( MAX_ITEMS, columnCount() - 1 ) );
+    emit dataChanged( createIndex( entries.size(), 0 ), createIndex( entries.size(), columnCount() - 1 ) );
 }
 
 void ListModel::addVideo(Video* video) {
-    
-    connect(video, SIGNAL(gotThumbnail()), this, SLOT(updateThumbnail()));
+    addVideos(QList<Video*>() << video);
+}
+
+void ListModel::addVideos(QList<Video*> newVideos) {
+    // result pages can overlap when the results change between requests
+    QMutableListIterator<Video*> i(newVideos);
+    while (i.hasNext()) {
+        Video *video = i.next();
+        if (video->id().isEmpty()) continue;
+        if (videoIds.contains(video->id())) {
+            i.remove();
+            delete video;
+        } else {
+            videoIds.insert(video->id());
+        }
+    }
+
+    if (newVideos.isEmpty()) return;
 
-    beginInsertRows(QModelIndex(), videos.size(), videos.size());
-    videos << video;
+    foreach (Video *video, newVideos)
+        connect(video, SIGNAL(gotThumbnail()), this, SLOT(updateThumbnail()));
+
+    const bool firstResults = entries.isEmpty();
+
+    // a single insertion for the whole page
+    beginInsertRows(QModelIndex(), entries.size(), entries.size() + newVideos.size() - 1);
+    foreach (Video *video, newVideos) {
+        Entry entry;
+        entry.video = video;
+        entries << entry;
+        videoRows.insert(video, entries.size() - 1);
+    }
     endInsertRows();
     
     // first result!
-    if (videos.size() == 1) {
+    if (firstResults) {
         // autoplay
         setActiveRow(0);
 
-        qDebug() << "you were right!";
-        qDebug() << video->title();
         if (searchParams) {
-            qDebug() << "shouldn't be here";
             // save keyword
             QString query = searchParams->keywords();
             QSettings settings;
@@ -301,11 +496,45 @@ void ListModel::updateThumbnail() {
         return;
     }
 
+    updateVideo(video);
+
+}
+
+void ListModel::updateVideo(Video *video) {
+
     int row = rowForVideo(video);
-    emit dataChanged( createIndex( row, 0 ), createIndex( row, columnCount() - 1 ) );
+    if (row == -1) return;
+
+    // it will be emitted by emitDataChanged()
+    changedVideos.insert(video);
+    if (!dataChangedTimer->isActive()) dataChangedTimer->start();
 
 }
 
+void ListModel::emitDataChanged() {
+    // rows may have been moved or removed in the meantime
+    QList<int> rows;
+    foreach (Video *video, changedVideos) {
+        const int row = rowForVideo(video);
+        if (row != -1) rows << row;
+    }
+    changedVideos.clear();
+    qSort(rows);
+
+    // one signal per run of adjacent rows, the rows in between did not change
+    int i = 0;
+    while (i < rows.size()) {
+        const int first = rows.at(i);
+        int last = first;
+        while (i < rows.size() - 1 && rows.at(i + 1) == last + 1) {
+            last++;
+            i++;
+        }
+        i++;
+        emit dataChanged( createIndex( first, 0 ), createIndex( last, columnCount() - 1 ) );
+    }
+}
+
 // --- item removal
 
 /**
@@ -314,27 +543,67 @@ void ListModel::updateThumbnail() {
 bool ListModel::removeRows(int position, int rows, const QModelIndex & /*parent*/) {
     beginRemoveRows(QModelIndex(), position, position+rows-1);
     for (int row = 0; row < rows; ++row) {
-        videos.removeAt(position);
+        const Entry entry = entries.takeAt(position);
+        if (entry.video) videoRows.remove(entry.video);
+        else recordsMemory -= entry.record.memoryUsage();
     }
+    compactedRows = qMin(compactedRows, position);
+    shiftVideoRows(position + rows, -rows);
     endRemoveRows();
     return true;
 }
 
 void ListModel::removeIndexes(QModelIndexList &indexes) {
-    QList<Video*> originalList(videos);
+    QList<int> rows = sortedRows(indexes);
+    if (rows.isEmpty()) return;
+
+    const int oldActiveRow = rowForVideo(m_activeVideo);
+    const bool activeRemoved = oldActiveRow != -1
+                               && qBinaryFind(rows, oldActiveRow) != rows.constEnd();
+
+    compactedRows = qMin(compactedRows, rows.first());
+
     QList<Video*> delitems;
-    foreach (QModelIndex index, indexes) {
-        Video* video = originalList.at(index.row());
-        int idx = videos.indexOf(video);
-        if (idx != -1) {
-            beginRemoveRows(QModelIndex(), idx, idx);
-            delitems.append(video);
-            videos.removeAll(video);
-            endRemoveRows();
+
+    // remove contiguous ranges, starting from the bottom
+    // so that the rows still to be removed keep their position
+    int i = rows.size() - 1;
+    while (i >= 0) {
+        const int last = rows.at(i);
+        int first = last;
+        while (i > 0 && rows.at(i - 1) == first - 1) {
+            first--;
+            i--;
+        }
+        i--;
+
+        beginRemoveRows(QModelIndex(), first, last);
+        QList<Entry>::iterator begin = entries.begin() + first;
+        QList<Entry>::iterator end = entries.begin() + last + 1;
+        for (QList<Entry>::iterator it = begin; it != end; ++it) {
+            if (it->video) {
+                videoRows.remove(it->video);
+                delitems.append(it->video);
+            } else recordsMemory -= it->record.memoryUsage();
         }
+        entries.erase(begin, end);
+        shiftVideoRows(last + 1, first - last - 1);
+        endRemoveRows();
+    }
+
+    // fix the active row
+    if (activeRemoved) {
+        // make nextRow() point to the video that followed the removed active one
+        const int removedAbove = qLowerBound(rows, oldActiveRow) - rows.constBegin();
+        m_activeVideo = 0;
+        m_activeRow = oldActiveRow - removedAbove - 1;
+    } else {
+        m_activeRow = rowForVideo(m_activeVideo);
     }
 
-    qDeleteAll(delitems);
+    // removing a large selection must not stall the GUI
+    foreach (Video *video, delitems)
+        discardVideo(video);
 
 }
 
@@ -350,7 +619,7 @@ Qt::ItemFlags ListModel::flags(const QModelIndex &index) const {
     Qt::ItemFlags defaultFlags = QAbstractListModel::flags(index);
 
     if (index.isValid()) {
-        if (index.row() == videos.size()) {
+        if (index.row() == entries.size()) {
             // don't drag the "show 10 more" item
             return defaultFlags;
         } else
@@ -370,8 +639,8 @@ QMimeData* ListModel::mimeData( const QModelIndexList &indexes ) const {
 
     foreach( const QModelIndex &it, indexes ) {
         int row = it.row();
-        if (row >= 0 && row < videos.size())
-            mime->addVideo( videos.at( it.row() ) );
+        if (row >= 0 && row < entries.size())
+            mime->addVideo( videoAt( it.row() ) );
     }
 
     return mime;
@@ -396,26 +665,68 @@ bool ListModel::dropMimeData(const QMimeData *data,
         beginRow = parent.row();
     else
         beginRow = rowCount(QModelIndex());
+    // never drop below the message item
+    beginRow = qMin(beginRow, entries.size());
 
     const VideoMimeData* videoMimeData = dynamic_cast<const VideoMimeData*>( data );
     if(!videoMimeData ) return false;
 
     QList<Video*> droppedVideos = videoMimeData->videos();
-    foreach( Video *video, droppedVideos) {
-        
-        // remove videos
-        int videoRow = videos.indexOf(video);
-        removeRows(videoRow, 1, QModelIndex());
-        
-        // and then add them again at the new position
-        beginInsertRows(QModelIndex(), beginRow, beginRow);
-        videos.insert(beginRow, video);
-        endInsertRows();
+    QList<int> rows;
+    foreach (Video *video, droppedVideos) {
+        int videoRow = rowForVideo(video);
+        if (videoRow != -1) rows << videoRow;
+    }
+    qSort(rows);
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    // split the dropped rows in contiguous ranges
+    QList<QPair<int, int> > ranges;
+    foreach (int videoRow, rows) {
+        if (!ranges.isEmpty() && ranges.last().second >= videoRow - 1)
+            ranges.last().second = videoRow;
+        else
+            ranges << qMakePair(videoRow, videoRow);
+    }
+
+    // rows moving up may not be compacted yet
+    if (!rows.isEmpty()) compactedRows = qMin(compactedRows, qMin(rows.first(), beginRow));
+
+    // a range the drop point falls into stays where it is
+    int aboveDestination = beginRow;
+    int belowDestination = beginRow;
+    for (int i = 0; i < ranges.size(); ++i) {
+        if (ranges.at(i).first < beginRow && ranges.at(i).second >= beginRow) {
+            aboveDestination = ranges.at(i).first;
+            belowDestination = ranges.at(i).second + 1;
+            ranges.removeAt(i);
+            break;
+        }
+    }
+
+    // move the ranges above the drop point, nearest first,
+    // each one ending right before the previous one
+    for (int i = ranges.size() - 1; i >= 0; --i) {
+        const int first = ranges.at(i).first;
+        const int last = ranges.at(i).second;
+        if (last >= aboveDestination) continue;
+        moveRows(first, last, aboveDestination);
+        aboveDestination -= last - first + 1;
+    }
 
+    // and then the ones below it, nearest first
+    for (int i = 0; i < ranges.size(); ++i) {
+        const int first = ranges.at(i).first;
+        const int last = ranges.at(i).second;
+        if (first < belowDestination) continue;
+        moveRows(first, last, belowDestination);
+        belowDestination += last - first + 1;
     }
+    if (!rows.isEmpty())
+        updateVideoRows(qMin(rows.first(), beginRow), qMax(rows.last(), beginRow - 1));
 
     // fix m_activeRow after all this
-    m_activeRow = videos.indexOf(m_activeVideo);
+    m_activeRow = rowForVideo(m_activeVideo);
 
     // let the MediaView restore the selection
     emit needSelectionFor(droppedVideos);
@@ -424,41 +735,146 @@ bool ListModel::dropMimeData(const QMimeData *data,
 
 }
 
-int ListModel::rowForVideo(Video* video) {
-    return videos.indexOf(video);
+int ListModel::rowForVideo(Video* video) const {
+    return videoRows.value(video, -1);
 }
 
-QModelIndex ListModel::indexForVideo(Video* video) {
-    return createIndex(videos.indexOf(video), 0);
+QModelIndex ListModel::indexForVideo(Video* video) const {
+    return createIndex(rowForVideo(video), 0);
 }
 
-void ListModel::move(QModelIndexList &indexes, bool up) {
-    QList<Video*> movedVideos;
+void ListModel::clearVideos() {
+    dataChangedTimer->stop();
+    changedVideos.clear();
+    videoIds.clear();
+    compactedRows = 0;
+    // only the live videos can have a thumbnail
+    const QList<Video*> liveVideos = videoRows.keys();
+    // let cached result pages keep the thumbnails we have loaded
+    The::searchCache()->updateThumbnails(liveVideos);
+    // Tearing down the old results must not delay the new ones.
+    // No per video work here: receivers ignore videos that are not in the list
+    // and deleting a video cancels its thumbnail request.
+    discardedVideos += liveVideos;
+    videoRows.clear();
+    entries.clear();
+    recordsMemory = 0;
+    if (!discardedVideos.isEmpty() && !discardTimer->isActive()) discardTimer->start();
+}
 
-    foreach (QModelIndex index, indexes) {
-        int row = index.row();
-        // qDebug() << "index row" << row;
-        Video *video = videoAt(row);
-        movedVideos << video;
+/**
+  * Detaches a video that is no longer in the list and schedules its deletion.
+  * Deleting hundreds of QObjects at once stalls the GUI right when
+  * a new search starts, so they go away in small chunks when idle.
+  */
+void ListModel::discardVideo(Video *video) {
+    video->cancelThumbnail();
+    changedVideos.remove(video);
+    // silence the Video signals but keep destroyed(),
+    // the playlist delegate drops its cached rows on it
+    const QMetaObject *metaObject = video->metaObject();
+    for (int i = QObject::staticMetaObject.methodCount(); i < metaObject->methodCount(); ++i) {
+        const QMetaMethod method = metaObject->method(i);
+        if (method.methodType() == QMetaMethod::Signal)
+            video->disconnect((QByteArray::number(QSIGNAL_CODE) + method.signature()).constData());
     }
+    discardedVideos << video;
+    if (!discardTimer->isActive()) discardTimer->start();
+}
+
+void ListModel::deleteDiscardedVideos() {
+    static const int chunkSize = 20;
+    for (int i = 0; i < chunkSize && !discardedVideos.isEmpty(); ++i)
+        delete discardedVideos.takeLast();
+    if (discardedVideos.isEmpty()) discardTimer->stop();
+}
 
-    int end=up ? -1 : rowCount()-1, mod=up ? -1 : 1;
-    foreach (Video *video, movedVideos) {
+/**
+  * Updates the row index of the videos from fromRow to toRow (the end of the list by default),
+  * call this after inserting, removing or moving videos in the middle of the list
+  */
+void ListModel::updateVideoRows(int fromRow, int toRow) {
+    if (toRow == -1 || toRow >= entries.size()) toRow = entries.size() - 1;
+    for (int row = fromRow; row <= toRow; ++row)
+        if (entries.at(row).video) videoRows.insert(entries.at(row).video, row);
+}
 
-        int row = rowForVideo(video);
-        if (row+mod==end) { end=row; continue; }
-        // qDebug() << "video row" << row;
-        removeRows(row, 1, QModelIndex());
+/**
+  * Adds delta to the row index of the videos at fromRow and below,
+  * call this after inserting or removing rows before them.
+  * Only the live videos are indexed, so this does not depend on the list length
+  */
+void ListModel::shiftVideoRows(int fromRow, int delta) {
+    QMutableHashIterator<Video*, int> it(videoRows);
+    while (it.hasNext()) {
+        it.next();
+        if (it.value() >= fromRow) it.setValue(it.value() + delta);
+    }
+}
 
-        if (up) row--;
-        else row++;
+void ListModel::move(QModelIndexList &indexes, bool up) {
+    QList<int> rows = sortedRows(indexes);
+    if (rows.isEmpty()) return;
 
-        beginInsertRows(QModelIndex(), row, row);
-        videos.insert(row, video);
-        endInsertRows();
+    QList<Video*> movedVideos;
+    foreach (int row, rows)
+        movedVideos << videoAt(row);
+    compactedRows = qMin(compactedRows, qMax(0, rows.first() - 1));
+
+    // move each contiguous range by one row.
+    // A range already at the top (or bottom) stays where it is.
+    int i = 0;
+    while (i < rows.size()) {
+        const int first = rows.at(i);
+        int last = first;
+        while (i < rows.size() - 1 && rows.at(i + 1) == last + 1) {
+            last++;
+            i++;
+        }
+        i++;
 
+        if (up && first > 0)
+            moveRows(first - 1, first - 1, last + 1);
+        else if (!up && last < entries.size() - 1)
+            moveRows(last + 1, last + 1, first);
     }
+    updateVideoRows(qMax(0, rows.first() - 1), rows.last() + 1);
+
+    // fix m_activeRow after all this
+    m_activeRow = rowForVideo(m_activeVideo);
 
     emit needSelectionFor(movedVideos);
 
 }
+
+/**
+  * Moves the rows from first to last before the destination row,
+  * destination is expressed in terms of the rows before the move.
+  * Only the rows in between are touched, call updateVideoRows() when done moving
+  */
+void ListModel::moveRows(int first, int last, int destination) {
+    if (!beginMoveRows(QModelIndex(), first, last, QModelIndex(), destination))
+        return;
+
+    QList<Entry>::iterator begin = entries.begin();
+    if (destination > last)
+        std::rotate(begin + first, begin + last + 1, begin + destination);
+    else
+        std::rotate(begin + destination, begin + first, begin + last + 1);
+
+    endMoveRows();
+}
+
+/**
+  * Returns the sorted, unique, video rows of indexes
+  */
+QList<int> ListModel::sortedRows(const QModelIndexList &indexes) const {
+    QList<int> rows;
+    foreach (QModelIndex index, indexes)
+        if (rowExists(index.row())) rows << index.row();
+    qSort(rows);
+    QList<int> uniqueRows;
+    foreach (int row, rows)
+        if (uniqueRows.isEmpty() || uniqueRows.last() != row) uniqueRows << row;
+    return uniqueRows;
+}
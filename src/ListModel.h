@@ -31,6 +31,8 @@ public:
     int columnCount( const QModelIndex& parent = QModelIndex() ) const { Q_UNUSED( parent ); return 4; }
     QVariant data(const QModelIndex &index, int role) const;
     bool removeRows(int position, int rows, const QModelIndex &parent);
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
 
     Qt::ItemFlags flags(const QModelIndex &index) const;
     QStringList mimeTypes() const;
@@ -42,54 +44,121 @@ public:
 
     // custom methods
     void setActiveRow( int row );
-    bool rowExists( int row ) const { return (( row >= 0 ) && ( row < videos.size() ) ); }
+    bool rowExists( int row ) const { return (( row >= 0 ) && ( row < entries.size() ) ); }
     int activeRow() const { return m_activeRow; } // returns -1 if there is no active row
     int nextRow() const;
     void removeIndexes(QModelIndexList &indexes);
-    int rowForVideo(Video* video);
-    QModelIndex indexForVideo(Video* video);
+    int rowForVideo(Video* video) const;
+    // repaints the row of video once the pending changes are flushed
+    void updateVideo(Video *video);
+    QModelIndex indexForVideo(Video* video) const;
     void move(QModelIndexList &indexes, bool up);
 
+    // creates the Video of a row that was released
     Video* videoAt( int row ) const;
     Video* activeVideo() const;
+    // Deletes the videos outside firstRow..lastRow, except the active and next ones.
+    // Their rows keep a VideoRecord and videoAt() brings them back.
+    void releaseVideos(int firstRow, int lastRow);
 
     // video search methods
     void search(SearchParams *searchParams);
     void abortSearch();
 
     void parseClipboard(SearchParams *searchParams);
+    void parseUrl(SearchParams *searchParams, const QString &url);
+    // appends the video at url to the list, returns false if it is not a video url
+    bool enqueueUrl(const QString &url);
+
+    // warm the search cache with the first page of the other sort orders
+    void prefetchSortOrders();
+
+    // estimated memory held by the videos in the list, in bytes
+    qint64 memoryUsage() const;
 
 public slots:
     void searchMore();
     void searchNeeded();
     void addVideo(Video* video);
+    void addVideos(QList<Video*> newVideos);
     void searchFinished(int total);
     void searchError(QString message);
     void updateThumbnail();
     void infoRead(Video *video);
 
+private slots:
+    void emitDataChanged();
+    void trimHistory();
+    void deleteDiscardedVideos();
+    void enqueueVideo(Video *video);
+
 signals:
     void activeRowChanged(int);
     void needSelectionFor(QList<Video*>);
+    // the outcome of enqueueUrl(), added is false if it was already in the list
+    void videoEnqueued(const QString &title, bool added);
 
 private:
     void searchMore(int max);
+    void clearVideos();
+    void discardVideo(Video *video);
+    void updateVideoRows(int fromRow, int toRow = -1);
+    void shiftVideoRows(int fromRow, int delta);
+    void moveRows(int first, int last, int destination);
+    QList<int> sortedRows(const QModelIndexList &indexes) const;
 
     YouTubeSearch *youtubeSearch;
+    YouTubeSearch *prefetchSearch;
+    bool prefetched;
     SearchParams *searchParams;
     bool searching;
     bool canSearchMore;
 
     bool justPastedVideo;
 
-    QList<Video*> videos;
+    // A playlist row. Only the rows around the visible and active ones
+    // have a Video, the others keep its record.
+    struct Entry {
+        Entry() : video(0) { }
+        Video *video;
+        VideoRecord record;
+    };
+    mutable QList<Entry> entries;
+    // row of each video, kept in sync with the entries list
+    mutable QHash<Video*, int> videoRows;
+    // the bytes held by the records
+    mutable qint64 recordsMemory;
+    // ids of the videos added since the last search, to drop duplicates across pages
+    QSet<QString> videoIds;
     int skip;
 
+    // the configured page size and the one adapted to the network latency
+    int pageSize;
+    int fetchSize;
+    // pages requested concurrently when a search starts
+    int searchPages;
+    QTime searchTime;
+
+    // videos no longer in the list, deleted a few at a time when idle
+    QList<Video*> discardedVideos;
+    QTimer *discardTimer;
+
+    // rows further than this behind the active one are compacted
+    int compactDistance;
+    // rows before this one are known to be compacted
+    int compactedRows;
+    // rows further than this behind the active one are removed, 0 keeps them all
+    int historySize;
+
     // the row being played
     int m_activeRow;
     Video *m_activeVideo;
 
     QString errorMessage;
+
+    // videos waiting for the coalesced dataChanged signal
+    QTimer *dataChangedTimer;
+    QSet<Video*> changedVideos;
 };
 
 #endif
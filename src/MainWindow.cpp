@@ -6,6 +6,7 @@
 #include "videodefinition.h"
 #include "fontutils.h"
 #include "globalshortcuts.h"
+#include "startuptrace.h"
 #ifdef Q_WS_X11
 #include "gnomeglobalshortcutbackend.h"
 #endif
@@ -28,8 +29,10 @@ MainWindow::MainWindow() :
     connect(searchView, SIGNAL(search(QString)), this, SLOT(showMedia(QString)));
     views->addWidget(searchView);
 
-    mediaView = new MediaView(this);
-    views->addWidget(mediaView);
+    // created by initMediaView() once the search view is on screen,
+    // or when the first search starts if that comes before
+    mediaView = 0;
+    connect(searchView, SIGNAL(firstPaint()), SLOT(initMediaView()));
 
     toolbarSearch = new SearchLineEdit(this);
     toolbarSearch->setFont(qApp->font());
@@ -41,16 +44,11 @@ MainWindow::MainWindow() :
     createMenus();
     createToolBars();
     createStatusBar();
-
-    initPhonon();
-    mediaView->setMediaObject(mediaObject);
+    StartupTrace::mark("actions and toolbars");
 
     // remove that useless menu/toolbar context menu
     this->setContextMenuPolicy(Qt::NoContextMenu);
 
-    // mediaView init stuff thats needs actions
-    mediaView->initialize();
-
     // cool toolbar on the Mac
     // this is too buggy to be enabled
     // setUnifiedTitleAndToolBarOnMac(true);
@@ -109,14 +107,12 @@ void MainWindow::createActions() {
     skipAct->setShortcuts(QList<QKeySequence>() << QKeySequence(Qt::CTRL + Qt::Key_Right) << QKeySequence(Qt::Key_MediaNext));
     skipAct->setEnabled(false);
     actions->insert("skip", skipAct);
-    connect(skipAct, SIGNAL(triggered()), mediaView, SLOT(skip()));
 
     pauseAct = new QAction(QtIconLoader::icon("media-playback-pause"), tr("&Pause"), this);
     pauseAct->setStatusTip(tr("Pause playback"));
     pauseAct->setShortcuts(QList<QKeySequence>() << QKeySequence(Qt::Key_Space) << QKeySequence(Qt::Key_MediaPlay));
     pauseAct->setEnabled(false);
     actions->insert("pause", pauseAct);
-    connect(pauseAct, SIGNAL(triggered()), mediaView, SLOT(pause()));
 
     fullscreenAct = new QAction(QtIconLoader::icon("view-fullscreen"), tr("&Full Screen"), this);
     fullscreenAct->setStatusTip(tr("Go full screen"));
@@ -139,21 +135,18 @@ void MainWindow::createActions() {
     webPageAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_Y));
     webPageAct->setEnabled(false);
     actions->insert("webpage", webPageAct);
-    connect(webPageAct, SIGNAL(triggered()), mediaView, SLOT(openWebPage()));
 
     copyPageAct = new QAction(tr("Copy the YouTube &link"), this);
     copyPageAct->setStatusTip(tr("Copy the current video YouTube link to the clipboard"));
     copyPageAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_L));
     copyPageAct->setEnabled(false);
     actions->insert("pagelink", copyPageAct);
-    connect(copyPageAct, SIGNAL(triggered()), mediaView, SLOT(copyWebPage()));
 
     copyLinkAct = new QAction(tr("Copy the video stream &URL"), this);
     copyLinkAct->setStatusTip(tr("Copy the current video stream URL to the clipboard"));
     copyLinkAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_U));
     copyLinkAct->setEnabled(false);
     actions->insert("videolink", copyLinkAct);
-    connect(copyLinkAct, SIGNAL(triggered()), mediaView, SLOT(copyVideoLink()));
 
     pasteLinkAct = new QAction(tr("Paste/play a Youtube link"), this);
     pasteLinkAct->setStatusTip(tr("Paste a Youtube link from clipboard and play it"));
@@ -167,21 +160,18 @@ void MainWindow::createActions() {
     removeAct->setShortcuts(QList<QKeySequence>() << QKeySequence("Del") << QKeySequence("Backspace"));
     removeAct->setEnabled(false);
     actions->insert("remove", removeAct);
-    connect(removeAct, SIGNAL(triggered()), mediaView, SLOT(removeSelected()));
 
     moveUpAct = new QAction(tr("Move &Up"), this);
     moveUpAct->setStatusTip(tr("Move up the selected videos in the playlist"));
     moveUpAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_Up));
     moveUpAct->setEnabled(false);
     actions->insert("moveUp", moveUpAct);
-    connect(moveUpAct, SIGNAL(triggered()), mediaView, SLOT(moveUpSelected()));
 
     moveDownAct = new QAction(tr("Move &Down"), this);
     moveDownAct->setStatusTip(tr("Move down the selected videos in the playlist"));
     moveDownAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_Down));
     moveDownAct->setEnabled(false);
     actions->insert("moveDown", moveDownAct);
-    connect(moveDownAct, SIGNAL(triggered()), mediaView, SLOT(moveDownSelected()));
 
     clearAct = new QAction(tr("&Clear recent keywords"), this);
     clearAct->setMenuRole(QAction::ApplicationSpecificRole);
@@ -248,6 +238,12 @@ void MainWindow::createActions() {
     connect(volumeMuteAct, SIGNAL(triggered()), SLOT(volumeMute()));
     addAction(volumeMuteAct);
 
+    // debug panel
+    latencyAct = new QAction(tr("Playback latency"), this);
+    latencyAct->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_L));
+    actions->insert("latency", latencyAct);
+    addAction(latencyAct);
+
     QAction *definitionAct = new QAction(this);
     definitionAct->setIcon(QtIconLoader::icon("video-display"));
     definitionAct->setShortcuts(QList<QKeySequence>() << QKeySequence(Qt::CTRL + Qt::Key_D));
@@ -415,19 +411,23 @@ void MainWindow::readSettings() {
     QSettings settings;
     restoreGeometry(settings.value("geometry").toByteArray());
     setDefinitionMode(settings.value("definition", VideoDefinition::getDefinitionNames().first()).toString());
-    audioOutput->setVolume(settings.value("volume", 1).toDouble());
-    audioOutput->setMuted(settings.value("volumeMute").toBool());
+    // volume is restored by initPhonon()
 }
 
 void MainWindow::writeSettings() {
+    QSettings settings;
+    // next time Auto definition starts from here
+    settings.setValue("bandwidthEstimate", The::bandwidthEstimator()->estimate());
     // do not save geometry when in full screen
     if (m_fullscreen)
         return;
-    QSettings settings;
     settings.setValue("geometry", saveGeometry());
-    settings.setValue("volume", audioOutput->volume());
-    settings.setValue("volumeMute", audioOutput->isMuted());
-    mediaView->saveSplitterState();
+    // nothing to save if the media view was never created
+    if (audioOutput) {
+        settings.setValue("volume", audioOutput->volume());
+        settings.setValue("volumeMute", audioOutput->isMuted());
+    }
+    if (mediaView) mediaView->saveSplitterState();
 }
 
 void MainWindow::goBack() {
@@ -543,6 +543,7 @@ void MainWindow::showSearch() {
 void MainWindow::showMedia(QString query) {
     SearchParams *searchParams = new SearchParams();
     searchParams->setKeywords(query);
+    initMediaView();
     mediaView->search(searchParams);
     showWidget(mediaView);
 }
@@ -596,7 +597,7 @@ void MainWindow::stateChanged(Phonon::State newState, Phonon::State /* oldState
 }
 
 void MainWindow::stop() {
-    mediaView->stop();
+    if (mediaView) mediaView->stop();
     showSearch();
 }
 
@@ -620,7 +621,7 @@ void MainWindow::fullscreen() {
     mainToolBar->setEnabled(m_fullscreen);
 
     // Hide anything but the video
-    mediaView->setPlaylistVisible(m_fullscreen);
+    if (mediaView) mediaView->setPlaylistVisible(m_fullscreen);
     statusBar()->setVisible(m_fullscreen);
 
 #ifndef APP_MAC
@@ -678,7 +679,7 @@ void MainWindow::compactView(bool enable) {
 
     mainToolBar->setVisible(!enable);
     mainToolBar->setEnabled(!enable);
-    mediaView->setPlaylistVisible(!enable);
+    if (mediaView) mediaView->setPlaylistVisible(!enable);
     statusBar()->setVisible(!enable);
 
 #ifndef APP_MAC
@@ -723,8 +724,14 @@ void MainWindow::initPhonon() {
     connect(mediaObject, SIGNAL(totalTimeChanged(qint64)), this, SLOT(totalTimeChanged(qint64)));
     seekSlider->setMediaObject(mediaObject);
     audioOutput = new Phonon::AudioOutput(Phonon::VideoCategory, this);
+    // restore the volume before connecting, no status bar message for this
+    QSettings settings;
+    audioOutput->setVolume(settings.value("volume", 1).toDouble());
+    audioOutput->setMuted(settings.value("volumeMute").toBool());
     connect(audioOutput, SIGNAL(volumeChanged(qreal)), this, SLOT(volumeChanged(qreal)));
     connect(audioOutput, SIGNAL(mutedChanged(bool)), this, SLOT(volumeMutedChanged(bool)));
+    if (audioOutput->isMuted())
+        volumeMuteAct->setIcon(QtIconLoader::icon("audio-volume-muted"));
     volumeSlider->setAudioOutput(audioOutput);
     Phonon::createPath(mediaObject, audioOutput);
 }
@@ -763,7 +770,36 @@ QString MainWindow::formatTime(qint64 time) {
     return timeString;
 }
 
+void MainWindow::initMediaView() {
+    if (mediaView) return;
+
+    mediaView = new MediaView(this);
+    views->addWidget(mediaView);
+
+    connect(skipAct, SIGNAL(triggered()), mediaView, SLOT(skip()));
+    connect(pauseAct, SIGNAL(triggered()), mediaView, SLOT(pause()));
+    connect(webPageAct, SIGNAL(triggered()), mediaView, SLOT(openWebPage()));
+    connect(copyPageAct, SIGNAL(triggered()), mediaView, SLOT(copyWebPage()));
+    connect(copyLinkAct, SIGNAL(triggered()), mediaView, SLOT(copyVideoLink()));
+    connect(removeAct, SIGNAL(triggered()), mediaView, SLOT(removeSelected()));
+    connect(moveUpAct, SIGNAL(triggered()), mediaView, SLOT(moveUpSelected()));
+    connect(moveDownAct, SIGNAL(triggered()), mediaView, SLOT(moveDownSelected()));
+    connect(latencyAct, SIGNAL(triggered()), mediaView, SLOT(showPlaybackLatency()));
+    StartupTrace::mark("media view");
+
+    initPhonon();
+    mediaView->setMediaObject(mediaObject);
+    StartupTrace::mark("phonon");
+
+    // mediaView init stuff thats needs actions
+    mediaView->initialize();
+
+    StartupTrace::mark("ready");
+    StartupTrace::dump();
+}
+
 void MainWindow::volumeUp() {
+    if (!audioOutput) return;
     qreal newVolume = volumeSlider->audioOutput()->volume() + .1;
     if (newVolume > volumeSlider->maximumVolume())
         newVolume = volumeSlider->maximumVolume();
@@ -771,6 +807,7 @@ void MainWindow::volumeUp() {
 }
 
 void MainWindow::volumeDown() {
+    if (!audioOutput) return;
     qreal newVolume = volumeSlider->audioOutput()->volume() - .1;
     if (newVolume < 0)
         newVolume = 0;
@@ -778,6 +815,7 @@ void MainWindow::volumeDown() {
 }
 
 void MainWindow::volumeMute() {
+    if (!audioOutput) return;
     volumeSlider->audioOutput()->setMuted(!volumeSlider->audioOutput()->isMuted());
 }
 
@@ -801,7 +839,12 @@ void MainWindow::volumeMutedChanged(bool muted) {
 void MainWindow::setDefinitionMode(QString definitionName) {
     QAction *definitionAct = The::globalActions()->value("definition");
     definitionAct->setText(definitionName);
-    definitionAct->setStatusTip(tr("Maximum video definition set to %1").arg(definitionAct->text())
+    QString statusTip;
+    if (definitionName == VideoDefinition::autoDefinitionName())
+        statusTip = tr("Video definition adapts to the network speed");
+    else
+        statusTip = tr("Maximum video definition set to %1").arg(definitionAct->text());
+    definitionAct->setStatusTip(statusTip
                                 + " (" +  definitionAct->shortcut().toString(QKeySequence::NativeText) + ")");
     statusBar()->showMessage(definitionAct->statusTip());
     QSettings settings;
@@ -833,7 +876,7 @@ void MainWindow::showFullscreenToolbar(bool show) {
 }
 
 void MainWindow::showFullscreenPlaylist(bool show) {
-    if (!m_fullscreen) return;
+    if (!m_fullscreen || !mediaView) return;
     mediaView->setPlaylistVisible(show);
 }
 
@@ -845,11 +888,40 @@ void MainWindow::clearRecentKeywords() {
 }
 
 void MainWindow::pasteVideoLink() {
+    playUrl(QApplication::clipboard()->text());
+}
+
+void MainWindow::playUrl(const QString &url) {
     SearchParams *searchParams = new SearchParams();
     searchParams->setKeywords(QString("random"));
-    mediaView->playFromClipboard(searchParams);
+    initMediaView();
+    mediaView->playUrl(searchParams, url);
     showWidget(mediaView);
 
     QString message = tr("Player should now start playing the pasted link");
     mediaView->search(searchParams);
 }
+
+void MainWindow::messageReceived(const QString &message) {
+    // "play" or "enqueue", a newline and the keywords or the YouTube url.
+    // Anything else, like the "Wake up!" of older versions, just raises the window.
+    const QString command = message.section('\n', 0, 0);
+    const QString argument = message.section('\n', 1).trimmed();
+    if (argument.isEmpty()) return;
+    if (command != "play" && command != "enqueue") return;
+
+    const bool isUrl = argument.startsWith("http://", Qt::CaseInsensitive);
+    if (!isUrl) {
+        showMedia(argument);
+        return;
+    }
+
+    // enqueue only makes sense if something is already playing
+    if (command == "enqueue" && mediaView && views->currentWidget() == mediaView
+        && mediaView->enqueueUrl(argument)) {
+        // the media view tells when the video is actually in the list
+        return;
+    }
+
+    playUrl(argument);
+}
@@ -21,6 +21,10 @@ public:
     MainWindow();
     ~MainWindow();
 
+public slots:
+    // handles the command line of this or of a later instance, see main.cpp
+    void messageReceived(const QString &message);
+
 protected:
     void closeEvent(QCloseEvent *);
     bool eventFilter(QObject *obj, QEvent *event);
@@ -58,6 +62,7 @@ private slots:
 
     // plays video from clipboard
     void pasteVideoLink();
+    void initMediaView();
 
 private:
     void initPhonon();
@@ -68,6 +73,7 @@ private:
     void readSettings();
     void writeSettings();
     void showWidget(QWidget*);
+    void playUrl(const QString &url);
     static QString formatTime(qint64 time);
 
     // view mechanism
@@ -103,6 +109,7 @@ private:
     QAction *volumeUpAct;
     QAction *volumeDownAct;
     QAction *volumeMuteAct;
+    QAction *latencyAct;
 
     // playlist actions
     QAction *removeAct;
@@ -5,11 +5,13 @@
 #include "minisplitter.h"
 #include "flickcharm.h"
 #include "constants.h"
+#include "bandwidthestimator.h"
 
 namespace The {
     QMap<QString, QAction*>* globalActions();
     QMap<QString, QMenu*>* globalMenus();
     QNetworkAccessManager* networkAccessManager();
+    BandwidthEstimator* bandwidthEstimator();
 }
 
 MediaView::MediaView(QWidget *parent) : QWidget(parent) {
@@ -71,6 +73,10 @@ MediaView::MediaView(QWidget *parent) : QWidget(parent) {
 
     listModel = new ListModel(this);
     connect(listModel, SIGNAL(activeRowChanged(int)), this, SLOT(activeRowChanged(int)));
+    connect(listModel, SIGNAL(videoEnqueued(QString,bool)), SLOT(videoEnqueued(QString,bool)));
+    // the delegate caches the rows it paints
+    connect(listModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+            listView->itemDelegate(), SLOT(dataChanged(QModelIndex,QModelIndex)));
     // needed to restore the selection after dragndrop
     connect(listModel, SIGNAL(needSelectionFor(QList<Video*>)), this, SLOT(selectVideos(QList<Video*>)));
     listView->setModel(listModel);
@@ -79,6 +85,21 @@ MediaView::MediaView(QWidget *parent) : QWidget(parent) {
             SIGNAL(selectionChanged ( const QItemSelection & , const QItemSelection & )),
             this, SLOT(selectionChanged ( const QItemSelection & , const QItemSelection & )));
 
+    // load thumbnails only for the rows the user can actually see
+    thumbnailTimer = new QTimer(this);
+    thumbnailTimer->setSingleShot(true);
+    thumbnailTimer->setInterval(50);
+    connect(thumbnailTimer, SIGNAL(timeout()), SLOT(loadVisibleThumbnails()));
+    connect(listView->verticalScrollBar(), SIGNAL(valueChanged(int)), thumbnailTimer, SLOT(start()));
+    connect(listModel, SIGNAL(rowsInserted(QModelIndex,int,int)), thumbnailTimer, SLOT(start()));
+    connect(listModel, SIGNAL(rowsRemoved(QModelIndex,int,int)), thumbnailTimer, SLOT(start()));
+    connect(listModel, SIGNAL(layoutChanged()), thumbnailTimer, SLOT(start()));
+    listView->viewport()->installEventFilter(this);
+
+    // the view fetches more results when scrolled to the very bottom,
+    // start a bit earlier so that the list is never empty under the user's scroll
+    connect(listView->verticalScrollBar(), SIGNAL(valueChanged(int)), SLOT(fetchMoreIfNeeded()));
+
     playlistWidget = new PlaylistWidget(this, sortBar, listView);
 
     splitter->addWidget(playlistWidget);
@@ -108,10 +129,23 @@ MediaView::MediaView(QWidget *parent) : QWidget(parent) {
     QSettings settings;
     splitter->restoreState(settings.value("splitter").toByteArray());
 
-    errorTimer = new QTimer(this);
-    errorTimer->setSingleShot(true);
-    errorTimer->setInterval(3000);
-    connect(errorTimer, SIGNAL(timeout()), SLOT(skipVideo()));
+    // how many rows beyond the visible ones get their thumbnail
+    thumbnailLookahead = settings.value("thumbnailLookahead", 5).toInt();
+    thumbnailKeep = qMax(thumbnailLookahead, settings.value("thumbnailKeep", 100).toInt());
+    speculativePrefetch = settings.value("speculativePrefetch", false).toBool();
+    gaplessPlayback = settings.value("gaplessPlayback", false).toBool();
+    gaplessTransition = false;
+
+    retries = 0;
+    resumePosition = 0;
+
+    // buffering longer than this is treated as a failure
+    stallTimer = new QTimer(this);
+    stallTimer->setSingleShot(true);
+    stallTimer->setInterval(settings.value("stallTimeout", 15).toInt() * 1000);
+    connect(stallTimer, SIGNAL(timeout()), SLOT(stalled()));
+    rebuffering = false;
+    bufferFillStart = -1;
 
     workaroundTimer = new QTimer(this);
     workaroundTimer->setSingleShot(true);
@@ -135,6 +169,12 @@ void MediaView::initialize() {
             this, SLOT(showVideoContextMenu(QPoint)));
 }
 
+bool MediaView::eventFilter(QObject *obj, QEvent *event) {
+    if (obj == listView->viewport() && event->type() == QEvent::Resize)
+        thumbnailTimer->start();
+    return QWidget::eventFilter(obj, event);
+}
+
 void MediaView::setMediaObject(Phonon::MediaObject *mediaObject) {
     this->mediaObject = mediaObject;
     Phonon::createPath(this->mediaObject, videoWidget);
@@ -144,6 +184,14 @@ void MediaView::setMediaObject(Phonon::MediaObject *mediaObject) {
     connect(mediaObject, SIGNAL(currentSourceChanged(Phonon::MediaSource)),
             this, SLOT(currentSourceChanged(Phonon::MediaSource)));
     connect(mediaObject, SIGNAL(bufferStatus(int)), loadingWidget, SLOT(bufferStatus(int)));
+    connect(mediaObject, SIGNAL(bufferStatus(int)), this, SLOT(bufferStatus(int)));
+
+    if (gaplessPlayback) {
+        // resolving a stream url takes a few requests, start well before the end
+        QSettings settings;
+        mediaObject->setPrefinishMark(settings.value("gaplessPrefinishMark", 20).toInt() * 1000);
+        connect(mediaObject, SIGNAL(prefinishMarkReached(qint32)), SLOT(prepareNextVideo()));
+    }
 }
 
 void MediaView::search(SearchParams *searchParams) {
@@ -155,7 +203,6 @@ void MediaView::search(SearchParams *searchParams) {
 
     videoAreaWidget->clear();
     workaroundTimer->stop();
-    errorTimer->stop();
 
     this->searchParams = searchParams;
 
@@ -170,15 +217,18 @@ void MediaView::search(SearchParams *searchParams) {
 }
 
 void MediaView::playFromClipboard(SearchParams *searchParams) {
+    playUrl(searchParams, QApplication::clipboard()->text());
+}
+
+void MediaView::playUrl(SearchParams *searchParams, const QString &url) {
     reallyStopped = false;
 
     videoAreaWidget->clear();
     workaroundTimer->stop();
-    errorTimer->stop();
 
     this->searchParams = searchParams;
 
-    listModel->parseClipboard(searchParams);
+    listModel->parseUrl(searchParams, url);
     listView->setFocus();
 }
 
@@ -186,14 +236,135 @@ void MediaView::disappear() {
     timerPlayFlag = true;
 }
 
+void MediaView::gotVideoToken() {
+    // a video that was skipped meanwhile is not the one we're timing
+    if (sender() != listModel->activeVideo()) return;
+    playbackLatency.mark(PlaybackLatency::Token);
+}
+
+void MediaView::gotDefinition() {
+    if (sender() != listModel->activeVideo()) return;
+    playbackLatency.mark(PlaybackLatency::Definition);
+}
+
+void MediaView::showPlaybackLatency() {
+    PlaybackLatencyDialog *dialog = new PlaybackLatencyDialog(&playbackLatency, this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
+void MediaView::videoEnqueued(const QString &title, bool added) {
+    QMainWindow* mainWindow = dynamic_cast<QMainWindow*>(window());
+    if (!mainWindow) return;
+    if (added)
+        mainWindow->statusBar()->showMessage(tr("%1 added to the playlist").arg(title));
+    else
+        mainWindow->statusBar()->showMessage(tr("%1 is already in the playlist").arg(title));
+}
+
 void MediaView::handleError(QString message) {
+    // a video we moved away from may still be reporting
+    Video *video = qobject_cast<Video*>(sender());
+    if (video && video != listModel->activeVideo()) return;
+
+    recover(classifyError(message), message);
+}
+
+void MediaView::stalled() {
+    qDebug() << "Stalled while buffering";
+    rebufferEnded();
+    recover(NetworkStall, tr("The network is too slow for this video"));
+}
+
+MediaView::Failure MediaView::classifyError(const QString &message) {
+    // neither Phonon nor the video info requests give us a status code,
+    // so look for it in the messages
+    if (message.contains("403") || message.contains("Forbidden", Qt::CaseInsensitive))
+        return ExpiredToken;
+    if (message.contains("404") || message.contains("Not Found", Qt::CaseInsensitive)
+        || message.contains("Cannot get video id"))
+        return NotFound;
+    if (message.contains("codec", Qt::CaseInsensitive)
+        || message.contains("decod", Qt::CaseInsensitive)
+        || message.contains("format", Qt::CaseInsensitive))
+        return DecoderFailure;
+    if (message.contains("timed out", Qt::CaseInsensitive))
+        return NetworkStall;
+    return UnknownFailure;
+}
+
+void MediaView::recover(Failure failure, const QString &message) {
+    stallTimer->stop();
+    Video *video = listModel->activeVideo();
+    if (!video || reallyStopped) return;
+
+    qDebug() << "Recovering from failure" << failure << message << "retries:" << retries;
+
+    // never loop forever on the same video
+    bool retry = retries < 2;
+    if (retry) {
+        switch (failure) {
+        case NotFound:
+            retry = false;
+            break;
+        case DecoderFailure:
+        case NetworkStall:
+            // a lower definition is easier on both the decoder and the network,
+            // otherwise a fresh stream url is worth a try
+            retry = video->lowerDefinition() || retries == 0;
+            break;
+        default:
+            // most often an expired token, ask for a new one
+            break;
+        }
+    }
+
+    if (retry) {
+        retries++;
+        const qint64 position = mediaObject->currentTime();
+        if (position > resumePosition) resumePosition = position;
+        videoAreaWidget->showLoading(video);
+        video->loadStreamUrl();
+        return;
+    }
+
+    // give up on this video and let the user know why
+    video->setFailureReason(message);
+    listModel->updateVideo(video);
     videoAreaWidget->showError(message);
-    skippedVideo = listModel->activeVideo();
-    // recover from errors by skipping to the next video
-    errorTimer->start(2000);
+    QMainWindow* mainWindow = dynamic_cast<QMainWindow*>(window());
+    if (mainWindow) mainWindow->statusBar()->showMessage(message);
+    skippedVideo = video;
+    QTimer::singleShot(0, this, SLOT(skipVideo()));
+}
+
+void MediaView::bufferStatus(int percent) {
+    if (mediaObject->state() == Phonon::BufferingState) {
+        // the first report is the baseline, what comes before it is latency
+        if (bufferFillStart < 0) {
+            bufferFillStart = percent;
+            bufferFillTime.start();
+        } else if (percent >= 100) {
+            Video *video = listModel->activeVideo();
+            if (video && video->getDefinitionCode())
+                The::bandwidthEstimator()->bufferFilled(video->getDefinitionCode(),
+                                                        percent - bufferFillStart, bufferFillTime.elapsed());
+            bufferFillStart = -1;
+        }
+    }
+    // not every backend gets here, PlayingState covers the others
+    if (percent >= 100) rebufferEnded();
 }
 
-void MediaView::stateChanged(Phonon::State newState, Phonon::State /*oldState*/)
+void MediaView::rebufferEnded() {
+    if (!rebuffering) return;
+    rebuffering = false;
+    Video *video = listModel->activeVideo();
+    if (video && video->getDefinitionCode())
+        The::bandwidthEstimator()->rebuffered(video->getDefinitionCode(), rebufferTime.elapsed());
+}
+
+void MediaView::stateChanged(Phonon::State newState, Phonon::State oldState)
 {
 
     // qDebug() << "Phonon state: " << newState << oldState;
@@ -207,11 +378,22 @@ void MediaView::stateChanged(Phonon::State newState, Phonon::State /*oldState*/)
 
     case Phonon::PlayingState:
         //qDebug("playing");
+        stallTimer->stop();
+        rebufferEnded();
+        playbackLatency.mark(PlaybackLatency::Playing);
         videoAreaWidget->showVideo();
+        // back where the failed stream left off
+        if (resumePosition > 0 && mediaObject->isSeekable()) {
+            mediaObject->seek(resumePosition);
+            resumePosition = 0;
+        }
+        // the stream is flowing, spare bandwidth can go to the sort bar
+        if (speculativePrefetch) listModel->prefetchSortOrders();
         break;
 
     case Phonon::StoppedState:
         //qDebug("stopped");
+        stallTimer->stop();
         // play() has already been called when setting the source
         // but Phonon on Linux needs a little more help to start playback
         if (!reallyStopped) mediaObject->play();
@@ -227,10 +409,19 @@ void MediaView::stateChanged(Phonon::State newState, Phonon::State /*oldState*/)
 
          case Phonon::PausedState:
         //qDebug("paused");
+        stallTimer->stop();
         break;
 
          case Phonon::BufferingState:
         //qDebug("buffering");
+        playbackLatency.mark(PlaybackLatency::Buffering);
+        stallTimer->start();
+        bufferFillStart = -1;
+        // the stream could not keep up with playback
+        if (oldState == Phonon::PlayingState && !rebuffering) {
+            rebuffering = true;
+            rebufferTime.start();
+        }
         break;
 
          case Phonon::LoadingState:
@@ -258,9 +449,11 @@ void MediaView::stop() {
     listModel->abortSearch();
     reallyStopped = true;
     mediaObject->stop();
+    mediaObject->clearQueue();
+    enqueuedVideo = 0;
     videoAreaWidget->clear();
     workaroundTimer->stop();
-    errorTimer->stop();
+    stallTimer->stop();
     listView->selectionModel()->clearSelection();
 }
 
@@ -273,18 +466,50 @@ void MediaView::activeRowChanged(int row) {
     // now that we have a new video to play
     // stop all the timers
     workaroundTimer->stop();
-    errorTimer->stop();
+    stallTimer->stop();
+    rebuffering = false;
+    retries = 0;
+    resumePosition = 0;
 
     qDebug() << "activeRowChanged";
 
+    connectVideo(video);
+    // trying again, forget the previous failure
+    video->resetDefinition();
+    if (!video->failureReason().isEmpty()) {
+        video->setFailureReason(QString());
+        listModel->updateVideo(video);
+    }
+
+    if (gaplessTransition) {
+        // Phonon is already playing it
+        gaplessTransition = false;
+        playbackLatency.start();
+        playbackLatency.mark(PlaybackLatency::Playing);
+        listModel->searchNeeded();
+        listView->scrollTo(listModel->index(row, 0, QModelIndex()), QAbstractItemView::EnsureVisible);
+        QMainWindow* mainWindow = dynamic_cast<QMainWindow*>(window());
+        if (mainWindow) mainWindow->statusBar()->showMessage(video->title());
+        return;
+    }
+
+    // anything queued is not what comes next anymore
+    const bool alreadyResolved = video == enqueuedVideo && video->getStreamUrl().isValid();
+    if (enqueuedVideo) {
+        mediaObject->clearQueue();
+        enqueuedVideo = 0;
+    }
+
     // immediately show the loading widget
     videoAreaWidget->showLoading(video);
 
-    connect(video, SIGNAL(gotStreamUrl(QUrl)), SLOT(gotStreamUrl(QUrl)));
-    // TODO handle signal in a proper slot and impl item error status
-    connect(video, SIGNAL(errorStreamUrl(QString)), SLOT(handleError(QString)));
+    playbackLatency.start();
+    if (!video->id().isEmpty())
+        playbackLatency.mark(PlaybackLatency::VideoId);
 
-    video->loadStreamUrl();
+    // skipped to the video that was being queued, its url is fresh
+    if (alreadyResolved) playStreamUrl(video->getStreamUrl());
+    else video->loadStreamUrl();
 
     // reset the timer flag
     timerPlayFlag = false;
@@ -296,12 +521,27 @@ void MediaView::activeRowChanged(int row) {
 
 }
 
+void MediaView::connectVideo(Video *video) {
+    connect(video, SIGNAL(gotVideoToken()), SLOT(gotVideoToken()), Qt::UniqueConnection);
+    connect(video, SIGNAL(gotDefinition(int)), SLOT(gotDefinition()), Qt::UniqueConnection);
+    connect(video, SIGNAL(gotStreamUrl(QUrl)), SLOT(gotStreamUrl(QUrl)), Qt::UniqueConnection);
+    connect(video, SIGNAL(errorStreamUrl(QString)), SLOT(handleError(QString)), Qt::UniqueConnection);
+}
+
 void MediaView::gotStreamUrl(QUrl streamUrl) {
+    // videos played earlier stay connected, the next one may be resolving for the queue
+    if (sender() != listModel->activeVideo()) return;
+    playStreamUrl(streamUrl);
+}
+
+void MediaView::playStreamUrl(const QUrl &streamUrl) {
     if (reallyStopped) return;
 
     // go!
     qDebug() << "Playing" << streamUrl.toString();
+    playbackLatency.mark(PlaybackLatency::StreamUrl);
     mediaObject->setCurrentSource(streamUrl);
+    playbackLatency.mark(PlaybackLatency::SourceSet);
     mediaObject->play();
 
     // ensure we always have 10 videos ahead
@@ -328,8 +568,34 @@ void MediaView::itemActivated(const QModelIndex &index) {
     else listModel->searchMore();
 }
 
-void MediaView::currentSourceChanged(const Phonon::MediaSource /* source */ ) {
+void MediaView::currentSourceChanged(const Phonon::MediaSource source) {
+    if (!enqueuedVideo || source.url() != enqueuedVideo->getStreamUrl()) return;
+
+    // Phonon moved on to the queued video by itself
+    Video *video = enqueuedVideo;
+    enqueuedVideo = 0;
+    gaplessTransition = true;
+    listModel->setActiveRow(listModel->rowForVideo(video));
+    gaplessTransition = false;
+}
+
+void MediaView::prepareNextVideo() {
+    Video *video = listModel->videoAt(listModel->nextRow());
+    if (!video || video == enqueuedVideo) return;
+
+    enqueuedVideo = video;
+    // connected now, a gapless transition makes it active without going through loadStreamUrl()
+    connectVideo(video);
+    video->resetDefinition();
+    connect(video, SIGNAL(gotStreamUrl(QUrl)), SLOT(gotNextStreamUrl(QUrl)), Qt::UniqueConnection);
+    video->loadStreamUrl();
+}
 
+void MediaView::gotNextStreamUrl(QUrl streamUrl) {
+    // the user may have moved on meanwhile
+    if (sender() != enqueuedVideo || reallyStopped) return;
+    qDebug() << "Queued" << streamUrl.toString();
+    mediaObject->enqueue(streamUrl);
 }
 
 void MediaView::skipVideo() {
@@ -461,6 +727,57 @@ void MediaView::timerPlay() {
     }
 }
 
+void MediaView::loadVisibleThumbnails() {
+    const int lastVideoRow = listModel->rowCount() - 1;
+    if (lastVideoRow < 0) return;
+
+    QModelIndex firstIndex = listView->indexAt(QPoint(0, 0));
+    QModelIndex lastIndex = listView->indexAt(QPoint(0, listView->viewport()->height() - 1));
+    const int firstRow = qMax(0, (firstIndex.isValid() ? firstIndex.row() : 0) - thumbnailLookahead);
+    const int lastRow = qMin(lastVideoRow, (lastIndex.isValid() ? lastIndex.row() : lastVideoRow) + thumbnailLookahead);
+
+    // cancel requests for rows that scrolled away
+    QMutableListIterator<QPointer<Video> > i(thumbnailVideos);
+    while (i.hasNext()) {
+        Video *video = i.next();
+        if (!video || !video->isThumbnailLoading()) {
+            i.remove();
+            continue;
+        }
+        const int row = listModel->rowForVideo(video);
+        if (row < firstRow || row > lastRow) {
+            video->cancelThumbnail();
+            i.remove();
+        }
+    }
+
+    for (int row = firstRow; row <= lastRow; row++) {
+        Video *video = listModel->videoAt(row);
+        if (!video || !video->thumbnail().isNull() || video->isThumbnailLoading()
+            || video->isThumbnailFailed()) continue;
+        video->preloadThumbnail();
+        if (video->isThumbnailLoading())
+            thumbnailVideos << QPointer<Video>(video);
+    }
+
+    // Only the rows around the visible ones have a Video and its thumbnail,
+    // so memory does not grow with the length of the list.
+    // Scrolling back creates them again and reloads the thumbnails from the store.
+    listModel->releaseVideos(firstRow - thumbnailKeep, lastRow + thumbnailKeep);
+}
+
+void MediaView::fetchMoreIfNeeded() {
+    if (!listModel->canFetchMore(QModelIndex())) return;
+
+    // within a screenful of the bottom?
+    QModelIndex firstIndex = listView->indexAt(QPoint(0, 0));
+    QModelIndex lastIndex = listView->indexAt(QPoint(0, listView->viewport()->height() - 1));
+    if (!firstIndex.isValid() || !lastIndex.isValid()) return;
+    const int visibleRows = lastIndex.row() - firstIndex.row() + 1;
+    if (lastIndex.row() + visibleRows >= listModel->rowCount() - 1)
+        listModel->fetchMore(QModelIndex());
+}
+
 void MediaView::saveSplitterState() {
     QSettings settings;
     settings.setValue("splitter", splitter->saveState());
@@ -12,6 +12,7 @@
 #include "playlistwidget.h"
 #include "loadingwidget.h"
 #include "videoareawidget.h"
+#include "playbacklatency.h"
 
 class MediaView : public QWidget, public View {
     Q_OBJECT
@@ -35,9 +36,14 @@ public:
 
     void setMediaObject(Phonon::MediaObject *mediaObject);
 
+protected:
+    bool eventFilter(QObject *obj, QEvent *event);
+
 public slots:
     void search(SearchParams *searchParams);
     void playFromClipboard(SearchParams *searchParams);
+    void playUrl(SearchParams *searchParams, const QString &url);
+    bool enqueueUrl(const QString &url) { return listModel->enqueueUrl(url); }
     void pause();
     void stop();
     void skip();
@@ -50,6 +56,7 @@ public slots:
     void moveDownSelected();
     void setPlaylistVisible(bool visible=true);
     void saveSplitterState();
+    void showPlaybackLatency();
 
 private slots:
     // list/model
@@ -58,10 +65,17 @@ private slots:
     void activeRowChanged(int);
     void selectVideos(QList<Video*> videos);
     void gotStreamUrl(QUrl streamUrl);
+    void gotVideoToken();
+    void gotDefinition();
     void handleError(QString message);
+    void stalled();
+    void videoEnqueued(const QString &title, bool added);
+    void bufferStatus(int percent);
     // phonon
     void stateChanged(Phonon::State newState, Phonon::State oldState);
     void currentSourceChanged(const Phonon::MediaSource source);
+    void prepareNextVideo();
+    void gotNextStreamUrl(QUrl streamUrl);
     void showVideoContextMenu(QPoint point);
     // bar
     void searchMostRelevant();
@@ -69,6 +83,10 @@ private slots:
     void searchMostViewed();
     // timer
     void timerPlay();
+    // thumbnails
+    void loadVisibleThumbnails();
+    // infinite scrolling
+    void fetchMoreIfNeeded();
 
 private:
 
@@ -97,10 +115,56 @@ private:
     bool timerPlayFlag;
     bool reallyStopped;
 
-    QTimer *errorTimer;
     QTimer *workaroundTimer;
     Video *skippedVideo;
 
+    // what went wrong, decides how to recover
+    enum Failure {
+        ExpiredToken, // 403, the stream url is not valid anymore
+        NotFound, // 404, the video is gone
+        DecoderFailure, // the backend cannot play this format
+        NetworkStall, // buffering for too long
+        UnknownFailure
+    };
+    static Failure classifyError(const QString &message);
+    void recover(Failure failure, const QString &message);
+    // recovery attempts for the active video
+    int retries;
+    // where to resume playback after reloading the active video
+    qint64 resumePosition;
+    QTimer *stallTimer;
+
+    // playback stopped to wait for data, reported to the bandwidth estimator
+    bool rebuffering;
+    QTime rebufferTime;
+    // the buffer fill rate while buffering, see bufferStatus()
+    int bufferFillStart;
+    QTime bufferFillTime;
+    void rebufferEnded();
+
+    // visible range driven thumbnail loading
+    QTimer *thumbnailTimer;
+    int thumbnailLookahead;
+    QList<QPointer<Video> > thumbnailVideos;
+    // rows beyond this distance from the visible ones release their video
+    int thumbnailKeep;
+
+    PlaybackLatency playbackLatency;
+
+    void playStreamUrl(const QUrl &streamUrl);
+    // the slots ignore a video until it is the active one
+    void connectVideo(Video *video);
+
+    // queue the next video in Phonon before the current one ends
+    bool gaplessPlayback;
+    // the video resolved and queued ahead of time, if any
+    QPointer<Video> enqueuedVideo;
+    // the active row is changing because Phonon moved to the queued video
+    bool gaplessTransition;
+
+    // fetch the other sort orders ahead of time once playback starts
+    bool speculativePrefetch;
+
 #ifdef APP_DEMO
     void demoExpired();
     int tracksPlayed;
@@ -1,6 +1,7 @@
 #include "SearchView.h"
 #include "constants.h"
 #include "fontutils.h"
+#include "startuptrace.h"
 
 namespace The {
     QMap<QString, QAction*>* globalActions();
@@ -106,7 +107,8 @@ SearchView::SearchView(QWidget *parent) : QWidget(parent) {
     setLayout(mainLayout);
 
     updateChecker = 0;
-    checkForUpdate();
+    // the update check waits until we're on screen
+    painted = false;
 }
 
 void SearchView::updateRecentKeywords() {
@@ -163,6 +165,11 @@ void SearchView::watch(QString query) {
     emit search(query);
 }
 
+void SearchView::afterFirstPaint() {
+    checkForUpdate();
+    emit firstPaint();
+}
+
 void SearchView::checkForUpdate() {
     static const QString updateCheckKey = "updateCheck";
 
@@ -202,6 +209,12 @@ void SearchView::gotNewVersion(QString version) {
 }
 
 void SearchView::paintEvent(QPaintEvent * /*event*/) {
+    if (!painted) {
+        painted = true;
+        StartupTrace::mark("first paint");
+        QTimer::singleShot(0, this, SLOT(afterFirstPaint()));
+    }
+
 #ifdef APP_MAC
     QBrush brush;
     if (window()->isActiveWindow()) {
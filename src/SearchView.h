@@ -36,6 +36,8 @@ public slots:
 
 signals:
     void search(QString query);
+    // the view is on screen, deferred startup work can begin
+    void firstPaint();
 
 protected:
     void paintEvent(QPaintEvent *);
@@ -43,6 +45,7 @@ protected:
 private slots:
     void watch();
     void textChanged(const QString &text);
+    void afterFirstPaint();
 
 private:
     void checkForUpdate();
@@ -54,6 +57,7 @@ private:
     QPushButton *watchButton;
 
     UpdateChecker *updateChecker;
+    bool painted;
 
 };
 
@@ -0,0 +1,76 @@
+#include "bandwidthestimator.h"
+#include "videodefinition.h"
+
+// transfers smaller than this mostly measure latency
+static const qint64 MIN_SAMPLE_BYTES = 32 * 1024;
+// rebuffering shorter than this is just a hiccup
+static const int MIN_REBUFFER_MSECS = 1000;
+// The playback time a full Phonon buffer holds. Backends do not tell,
+// this is in the range of what they prebuffer before playing.
+static const int BUFFER_MSECS = 5000;
+// fills quicker than this are mostly timer resolution
+static const int MIN_FILL_MSECS = 200;
+
+BandwidthEstimator::BandwidthEstimator(int estimate) :
+        m_estimate(estimate),
+        currentCode(0) { }
+
+void BandwidthEstimator::addSample(qint64 bytes, int msecs) {
+    if (bytes < MIN_SAMPLE_BYTES || msecs <= 0) return;
+
+    smooth(bytes * 8 / msecs);
+}
+
+void BandwidthEstimator::bufferFilled(int definitionCode, int percent, int msecs) {
+    if (percent <= 0 || msecs < MIN_FILL_MSECS) return;
+
+    // nothing is played meanwhile, so the buffer fills at the link speed
+    // and holds the playback time of the definition bitrate
+    smooth(qint64(bitrate(definitionCode)) * BUFFER_MSECS * percent / 100 / msecs);
+}
+
+void BandwidthEstimator::smooth(int kbps) {
+    // smooth out single fast or slow samples
+    if (m_estimate) m_estimate = (m_estimate * 7 + kbps * 3) / 10;
+    else m_estimate = kbps;
+    // qDebug() << "Bandwidth sample" << kbps << "estimate" << m_estimate;
+}
+
+void BandwidthEstimator::rebuffered(int definitionCode, int msecs) {
+    if (msecs < MIN_REBUFFER_MSECS) return;
+
+    // whatever the transfers said, this definition was too much
+    const int ceiling = bitrate(definitionCode) * 8 / 10;
+    if (!m_estimate || m_estimate > ceiling) m_estimate = ceiling;
+    qDebug() << "Rebuffered for" << msecs << "ms at" << definitionCode << "estimate" << m_estimate;
+}
+
+int BandwidthEstimator::definitionCode() {
+    const QList<int> definitionCodes = VideoDefinition::getDefinitionCodes();
+
+    // nothing measured yet, be safe
+    if (!m_estimate) return definitionCodes.first();
+
+    const int currentIndex = definitionCodes.indexOf(currentCode);
+    int code = definitionCodes.first();
+    for (int i = 0; i < definitionCodes.size(); i++) {
+        // going up needs more headroom than staying
+        // so that the choice does not flip at every sample
+        const int margin = i > currentIndex ? 15 : 11;
+        if (m_estimate * 10 >= bitrate(definitionCodes.at(i)) * margin)
+            code = definitionCodes.at(i);
+    }
+
+    if (code != currentCode)
+        qDebug() << "Auto definition" << code << "estimate" << m_estimate;
+    currentCode = code;
+    return code;
+}
+
+int BandwidthEstimator::bitrate(int definitionCode) {
+    switch (definitionCode) {
+    case 37: return 4500;
+    case 22: return 2500;
+    default: return 600;
+    }
+}
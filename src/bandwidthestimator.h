@@ -0,0 +1,34 @@
+#ifndef BANDWIDTHESTIMATOR_H
+#define BANDWIDTHESTIMATOR_H
+
+#include <QtCore>
+
+/**
+  * Keeps a running estimate of the link throughput
+  * and picks the highest definition it can sustain.
+  * Fed by finished network transfers and by Phonon buffering.
+  */
+class BandwidthEstimator {
+
+public:
+    // estimate in kbit/s, 0 when unknown
+    BandwidthEstimator(int estimate);
+    void addSample(qint64 bytes, int msecs);
+    // playback at definitionCode stalled for msecs
+    void rebuffered(int definitionCode, int msecs);
+    // with playback at definitionCode stopped, the backend buffer filled by percent in msecs
+    void bufferFilled(int definitionCode, int percent, int msecs);
+    int estimate() const { return m_estimate; }
+    int definitionCode();
+    // kbit/s needed to play a definition without stalls
+    static int bitrate(int definitionCode);
+
+private:
+    void smooth(int kbps);
+    int m_estimate;
+    // the last choice, switching away from it needs a clear margin
+    int currentCode;
+
+};
+
+#endif // BANDWIDTHESTIMATOR_H
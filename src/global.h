@@ -8,6 +8,9 @@
 #include <QNetworkProxyFactory>
 #include <cstdlib>
 #include "networkaccess.h"
+#include "thumbnailstore.h"
+#include "searchcache.h"
+#include "bandwidthestimator.h"
 
 namespace The {
 
@@ -152,6 +155,42 @@ namespace The {
         return g_http;
     }
 
+    static ThumbnailStore *g_thumbnailStore = 0;
+    ThumbnailStore* thumbnailStore() {
+        if (!g_thumbnailStore) {
+            QSettings settings;
+            QString location = QDesktopServices::storageLocation(QDesktopServices::CacheLocation)
+                               + "/thumbnails";
+            // size in MB
+            qint64 maxSize = settings.value("thumbnailStoreSize", 20).toInt() * 1024 * 1024;
+            g_thumbnailStore = new ThumbnailStore(location, maxSize);
+        }
+        return g_thumbnailStore;
+    }
+
+    static SearchCache *g_searchCache = 0;
+    SearchCache* searchCache() {
+        if (!g_searchCache) {
+            QSettings settings;
+            // size in MB
+            qint64 maxSize = settings.value("searchCacheSize", 8).toInt() * 1024 * 1024;
+            // seconds before a cached page is considered stale
+            int timeToLive = settings.value("searchCacheTimeToLive", 300).toInt();
+            g_searchCache = new SearchCache(maxSize, timeToLive);
+        }
+        return g_searchCache;
+    }
+
+    static BandwidthEstimator *g_bandwidthEstimator = 0;
+    BandwidthEstimator* bandwidthEstimator() {
+        if (!g_bandwidthEstimator) {
+            QSettings settings;
+            // start from what was measured last time, in kbit/s
+            g_bandwidthEstimator = new BandwidthEstimator(settings.value("bandwidthEstimate", 0).toInt());
+        }
+        return g_bandwidthEstimator;
+    }
+
 }
 
 #endif // GLOBAL_H
@@ -3,14 +3,21 @@
 
 #define GSUGGEST_URL "http://suggestqueries.google.com/complete/search?ds=yt&output=toolbar&hl=%1&q=%2"
 
+static const QString recentKeywordsKey = "recentKeywords";
+static const int maxSuggestions = 10;
+
 namespace The {
     NetworkAccess* http();
 }
 
 GSuggestCompletion::GSuggestCompletion(QWidget *parent, QLineEdit *editor):
-        QObject(parent), buddy(parent), editor(editor) {
+        QObject(parent), buddy(parent), editor(editor), suggestionCache(500) {
 
     enabled = true;
+    generation = 0;
+    completionsShown = 0;
+    loadRecentKeywords();
+    roundTripTime = 400;
 
     popup = new QListWidget;
     popup->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -36,6 +43,8 @@ GSuggestCompletion::GSuggestCompletion(QWidget *parent, QLineEdit *editor):
     timer->setInterval(300);
     connect(timer, SIGNAL(timeout()), SLOT(autoSuggest()));
     connect(editor, SIGNAL(textEdited(QString)), timer, SLOT(start()));
+    // must come after the timer connection, it may stop it
+    connect(editor, SIGNAL(textEdited(QString)), SLOT(instantSuggest()));
 
 }
 
@@ -89,13 +98,16 @@ bool GSuggestCompletion::eventFilter(QObject *obj, QEvent *ev) {
         case Qt::Key_PageDown:
             break;
 
-        default:
+        default: {
             // qDebug() << keyEvent->text();
+            const uint shown = completionsShown;
             editor->setFocus();
             editor->event(ev);
-            popup->hide();
+            // keep the popup if the instant suggestions just refreshed it
+            if (completionsShown == shown) popup->hide();
             break;
         }
+        }
 
         return consumed;
     }
@@ -107,25 +119,35 @@ void GSuggestCompletion::showCompletion(const QStringList &choices) {
 
     if (choices.isEmpty())
         return;
+    completionsShown++;
 
+    // Update the existing rows in place, the popup is refreshed on every keystroke
+    // and recreating the items makes it flicker
+    const int oldCount = popup->count();
     popup->setUpdatesEnabled(false);
-    popup->clear();
     for (int i = 0; i < choices.count(); ++i) {
-        QListWidgetItem * item;
-        item = new QListWidgetItem(popup);
-        item->setText(choices[i]);
+        QListWidgetItem *item = popup->item(i);
+        if (!item) item = new QListWidgetItem(popup);
+        if (item->text() != choices[i]) item->setText(choices[i]);
     }
+    while (popup->count() > choices.count())
+        delete popup->takeItem(popup->count() - 1);
     popup->setCurrentItem(0);
-    popup->adjustSize();
     popup->setUpdatesEnabled(true);
 
-    int h = popup->sizeHintForRow(0) * choices.count() + 4;
-    popup->resize(buddy->width(), h);
+    // relayout only when the geometry actually changes
+    if (popup->count() != oldCount || popup->width() != buddy->width()) {
+        int h = popup->sizeHintForRow(0) * choices.count() + 4;
+        popup->resize(buddy->width(), h);
+    }
 
-    popup->move(buddy->mapToGlobal(QPoint(0, buddy->height())));
+    const QPoint pos = buddy->mapToGlobal(QPoint(0, buddy->height()));
+    if (popup->pos() != pos) popup->move(pos);
 
-    popup->setFocus();
-    popup->show();
+    if (!popup->isVisible()) {
+        popup->setFocus();
+        popup->show();
+    }
 }
 
 void GSuggestCompletion::doneCompletion() {
@@ -146,15 +168,23 @@ void GSuggestCompletion::doneCompletion() {
 void GSuggestCompletion::preventSuggest() {
     // qDebug() << "preventSuggest";
     timer->stop();
+    if (reply) reply->abort();
     enabled = false;
     popup->hide();
 }
 
 void GSuggestCompletion::enableSuggest() {
     // qDebug() << "enableSuggest";
+    // suggestions were off while searching, the search may have added a keyword
+    if (!enabled) loadRecentKeywords();
     enabled = true;
 }
 
+void GSuggestCompletion::loadRecentKeywords() {
+    QSettings settings;
+    recentKeywords = settings.value(recentKeywordsKey).toStringList();
+}
+
 void GSuggestCompletion::autoSuggest() {
     if (!enabled) return;
 
@@ -171,11 +201,83 @@ void GSuggestCompletion::autoSuggest() {
 
     QString url = QString(GSUGGEST_URL).arg(locale, query);
 
-    QObject *reply = The::http()->get(url);
+    // its answer would be stale, don't let it hold a connection
+    if (reply) reply->abort();
+
+    generation++;
+    requestTime.start();
+    reply = The::http()->get(url);
+    reply->setProperty("query", query);
+    reply->setProperty("generation", generation);
     connect(reply, SIGNAL(data(QByteArray)), SLOT(handleNetworkData(QByteArray)));
 }
 
+/**
+  * Shows what we already know about the text being typed without waiting for the network:
+  * matching recent keywords and the cached response for the query or for one of its prefixes.
+  */
+void GSuggestCompletion::instantSuggest() {
+    if (!enabled) return;
+
+    QString query = editor->text();
+    if (query.isEmpty()) return;
+
+    bool exact;
+    QStringList choices = localSuggestions(query, &exact);
+    // a cached response for this very query is as good as a new one
+    if (exact) {
+        timer->stop();
+        if (reply) reply->abort();
+    }
+    if (choices.isEmpty()) return;
+
+    originalText = query;
+    showCompletion(choices);
+}
+
+QStringList GSuggestCompletion::localSuggestions(const QString &query, bool *exact) {
+    QStringList choices;
+    QSet<QString> seen;
+
+    foreach (QString keyword, recentKeywords) {
+        if (keyword.startsWith(query, Qt::CaseInsensitive) && !seen.contains(keyword.toLower())) {
+            seen.insert(keyword.toLower());
+            choices << keyword;
+        }
+    }
+
+    // the longest cached prefix, its suggestions narrowed down to the query
+    const QString key = query.toLower();
+    QStringList *cached = 0;
+    int length = key.length();
+    while (length > 0 && !(cached = suggestionCache.object(key.left(length))))
+        --length;
+    *exact = cached && length == key.length();
+
+    if (cached) {
+        foreach (QString suggestion, *cached) {
+            if (choices.size() >= maxSuggestions) break;
+            if (seen.contains(suggestion.toLower())) continue;
+            if (*exact || suggestion.startsWith(query, Qt::CaseInsensitive)) {
+                seen.insert(suggestion.toLower());
+                choices << suggestion;
+            }
+        }
+    }
+
+    return choices.mid(0, maxSuggestions);
+}
+
 void GSuggestCompletion::handleNetworkData(QByteArray response) {
+    // a late answer to a query that has been superseded
+    if (sender()->property("generation").toUInt() != generation) return;
+    reply = 0;
+
+    // On a slow link wait longer between keystrokes before asking,
+    // fewer requests compete with the searches and the video stream.
+    roundTripTime = (roundTripTime * 3 + requestTime.elapsed()) / 4;
+    timer->setInterval(qBound(150, roundTripTime / 2 + 100, 1000));
+
     if (!enabled) return;
 
     QStringList choices;
@@ -190,6 +292,16 @@ void GSuggestCompletion::handleNetworkData(QByteArray response) {
         }
     }
 
+    const QString query = sender()->property("query").toString();
+    suggestionCache.insert(query.toLower(), new QStringList(choices));
+
+    // the user kept typing, this one is only good for the cache
+    if (query != editor->text()) return;
+
+    // merge in the recent keywords
+    bool exact;
+    choices = localSuggestions(query, &exact);
+    originalText = query;
     showCompletion(choices);
 
 }
@@ -3,6 +3,8 @@
 
 #include <QtGui>
 
+class NetworkReply;
+
 class GSuggestCompletion : public QObject {
     Q_OBJECT
 
@@ -17,16 +19,35 @@ public slots:
     void preventSuggest();
     void enableSuggest();
     void autoSuggest();
+    void instantSuggest();
     void handleNetworkData(QByteArray response);
     void currentItemChanged(QListWidgetItem *current);
 
 private:
+    QStringList localSuggestions(const QString &query, bool *exact);
+    void loadRecentKeywords();
+
     QWidget *buddy;
     QLineEdit *editor;
     QString originalText;
     QListWidget *popup;
     QTimer *timer;
     bool enabled;
+    // the request in flight, aborted when a newer query is sent
+    QPointer<NetworkReply> reply;
+    // incremented for every request, responses from older ones are dropped
+    uint generation;
+    QTime requestTime;
+    // smoothed round trip time of the suggest requests, in ms
+    int roundTripTime;
+
+    // bumped by showCompletion(), tells if a keystroke refreshed the popup
+    uint completionsShown;
+    // read from the settings when a search may have added one
+    QStringList recentKeywords;
+
+    // previous responses by lowercased query
+    QCache<QString, QStringList> suggestionCache;
 
 };
 
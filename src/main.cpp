@@ -1,20 +1,58 @@
 #include <QtGui>
 #include <qtsingleapplication.h>
+#include <qtlocalpeer.h>
 #include "constants.h"
 #include "MainWindow.h"
+#include "startuptrace.h"
 #ifdef APP_MAC
 #include "local/mac/mac_startup.h"
 #endif
 
+// the same for every installation, so that any launcher finds the running instance
+static const QString appId = "minitube";
+
+/**
+  * The message for the running instance, see MainWindow::messageReceived().
+  * Usage: minitube [--enqueue] [keywords | YouTube url]
+  */
+static QString commandLineMessage(int argc, char **argv) {
+    bool enqueue = false;
+    QStringList words;
+    for (int i = 1; i < argc; i++) {
+        const QString arg = QString::fromLocal8Bit(argv[i]);
+        if (arg == "--enqueue") enqueue = true;
+        // other options, like the -psn_ one on the Mac, are not for us
+        else if (!arg.startsWith('-')) words << arg;
+    }
+    if (words.isEmpty()) return "Wake up!";
+    return QString(enqueue ? "enqueue" : "play") + '\n' + words.join(" ");
+}
+
 int main(int argc, char **argv) {
 
+    StartupTrace::mark("main");
+
 #ifdef APP_MAC
     mac::MacMain();
 #endif
 
-    QtSingleApplication app(argc, argv);
-    if (app.sendMessage("Wake up!"))
+    // Hand the command line to the running instance, if any, before paying
+    // for the application object. The peer only needs the lock file and
+    // the blocking local socket calls, none of which use an event loop.
+    const QString message = commandLineMessage(argc, argv);
+    {
+        QtLocalPeer peer(0, appId);
+        if (peer.isClient() && peer.sendMessage(message, 1000))
+            return 0;
+        // going out of scope releases the lock for the application's own peer
+    }
+    StartupTrace::mark("instance check");
+
+    QtSingleApplication app(appId, argc, argv);
+    // another instance may have started meanwhile
+    if (app.isRunning() && app.sendMessage(message, 1000))
         return 0;
+    StartupTrace::mark("application");
 
     app.setApplicationName(Constants::APP_NAME);
     app.setOrganizationName(Constants::ORG_NAME);
@@ -47,9 +85,11 @@ int main(int argc, char **argv) {
     translator.load(locale, localeDir);
     app.installTranslator(&translator);
     QTextCodec::setCodecForTr(QTextCodec::codecForName("utf8"));
+    StartupTrace::mark("translations");
 
     MainWindow mainWin;
     mainWin.setWindowTitle(Constants::APP_NAME);
+    StartupTrace::mark("main window");
 
 // no window icon on Mac
 #ifndef APP_MAC
@@ -65,11 +105,18 @@ int main(int argc, char **argv) {
         appIcon.addFile(png, QSize(iconSizes[i], iconSizes[i]));
     }
     mainWin.setWindowIcon(appIcon);
+    StartupTrace::mark("icon");
 #endif
 
     mainWin.show();
+    StartupTrace::mark("show");
 
     app.setActivationWindow(&mainWin, true);
+    QObject::connect(&app, SIGNAL(messageReceived(const QString&)),
+                     &mainWin, SLOT(messageReceived(const QString&)));
+    // our own command line goes the same way
+    QMetaObject::invokeMethod(&mainWin, "messageReceived", Qt::QueuedConnection,
+                              Q_ARG(QString, message));
 
     // all string literals are UTF-8
     QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
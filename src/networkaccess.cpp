@@ -1,9 +1,11 @@
 #include "networkaccess.h"
 #include "constants.h"
+#include "bandwidthestimator.h"
 #include <QtGui>
 
 namespace The {
     NetworkAccess* http();
+    BandwidthEstimator* bandwidthEstimator();
 }
 
 const QString USER_AGENT = QString(Constants::APP_NAME)
@@ -12,6 +14,16 @@ const QString USER_AGENT = QString(Constants::APP_NAME)
 
 NetworkReply::NetworkReply(QNetworkReply *networkReply) : QObject(networkReply) {
     this->networkReply = networkReply;
+    firstBytes = 0;
+    connect(networkReply, SIGNAL(downloadProgress(qint64,qint64)),
+            SLOT(downloadProgress(qint64,qint64)));
+}
+
+void NetworkReply::downloadProgress(qint64 bytesReceived, qint64 /* bytesTotal */) {
+    if (transferTime.isNull() && bytesReceived > 0) {
+        transferTime.start();
+        firstBytes = bytesReceived;
+    }
 }
 
 void NetworkReply::finished() {
@@ -27,6 +39,12 @@ void NetworkReply::finished() {
         networkReply->deleteLater();
         networkReply = redirectReply;
 
+        // time the new transfer only
+        transferTime = QTime();
+        firstBytes = 0;
+        connect(networkReply, SIGNAL(downloadProgress(qint64,qint64)),
+                SLOT(downloadProgress(qint64,qint64)));
+
         // when the request is finished we'll invoke the target method
         connect(networkReply, SIGNAL(finished()), this, SLOT(finished()), Qt::AutoConnection);
 
@@ -34,10 +52,19 @@ void NetworkReply::finished() {
     }
 
 
+    // aborted requests have nothing to deliver
+    if (networkReply->error() == QNetworkReply::OperationCanceledError) {
+        networkReply->deleteLater();
+        return;
+    }
+
     emit finished(networkReply);
 
     // get the HTTP response body
     QByteArray bytes = networkReply->readAll();
+    // a body that came in a single chunk says nothing about the throughput
+    if (!transferTime.isNull())
+        The::bandwidthEstimator()->addSample(bytes.size() - firstBytes, transferTime.elapsed());
 
     emit data(bytes);
 
@@ -50,6 +77,10 @@ void NetworkReply::requestError(QNetworkReply::NetworkError code) {
     emit error(networkReply);
 }
 
+void NetworkReply::abort() {
+    networkReply->abort();
+}
+
 /* --- NetworkAccess --- */
 
 NetworkAccess::NetworkAccess( QObject* parent) : QObject( parent ) {}
@@ -186,6 +217,10 @@ void NetworkAccess::error(QNetworkReply::NetworkError code) {
     if (networkReply->operation() == QNetworkAccessManager::HeadOperation)
         return;
 
+    // Ignore requests we aborted ourselves
+    if (code == QNetworkReply::OperationCanceledError)
+        return;
+
     // report the error in the status bar
     QMainWindow* mainWindow = dynamic_cast<QMainWindow*>(qApp->topLevelWidgets().first());
     if (mainWindow) mainWindow->statusBar()->showMessage(
@@ -17,6 +17,10 @@ public:
 public slots:
     void finished();
     void requestError(QNetworkReply::NetworkError);
+    void abort();
+
+private slots:
+    void downloadProgress(qint64 bytesReceived, qint64 bytesTotal);
 
 signals:
     void data(QByteArray);
@@ -25,6 +29,10 @@ signals:
 
 private:
     QNetworkReply *networkReply;
+    // to measure the transfer rate, from the first received bytes
+    // so that the request latency is left out
+    QTime transferTime;
+    qint64 firstBytes;
 
 };
 
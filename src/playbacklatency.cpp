@@ -0,0 +1,144 @@
+#include "playbacklatency.h"
+
+// upper bounds of the histogram buckets, in ms
+static const int bucketBounds[] = { 250, 500, 1000, 2000, 4000, 8000 };
+static const int bucketCount = sizeof(bucketBounds) / sizeof(int);
+
+PlaybackLatency::PlaybackLatency(int maxPlays) :
+        maxPlays(maxPlays),
+        running(false) { }
+
+void PlaybackLatency::start() {
+    if (running) finish();
+    currentPlay = QVector<int>(PhaseCount, -1);
+    running = true;
+    time.start();
+    currentPlay[Activated] = 0;
+}
+
+void PlaybackLatency::mark(Phase phase) {
+    if (!running || currentPlay.at(phase) != -1) return;
+    currentPlay[phase] = time.elapsed();
+    if (phase == Playing) {
+        qDebug() << "Playback started in" << currentPlay.at(phase) << "ms";
+        finish();
+    }
+}
+
+void PlaybackLatency::finish() {
+    running = false;
+    plays << currentPlay;
+    while (plays.size() > maxPlays)
+        plays.removeFirst();
+}
+
+QString PlaybackLatency::phaseName(int phase) {
+    static const char *names[] = {
+        "activated", "video id", "token", "definition",
+        "stream url", "source set", "buffering", "playing"
+    };
+    if (phase < 0 || phase >= PhaseCount) return QString();
+    return names[phase];
+}
+
+QString PlaybackLatency::report() const {
+    QString report;
+    QTextStream out(&report);
+
+    out << "Last " << plays.size() << " plays, ms since the row was activated\n\n";
+
+    out << qSetFieldWidth(12) << left << "phase" << right << "count" << "median" << "p90" << "max";
+    for (int i = 0; i < bucketCount; ++i)
+        out << QString("<%1").arg(bucketBounds[i]);
+    out << QString(">=%1").arg(bucketBounds[bucketCount - 1]) << qSetFieldWidth(0) << "\n";
+
+    for (int phase = VideoId; phase < PhaseCount; ++phase) {
+        QList<int> samples;
+        foreach (QVector<int> play, plays)
+            if (play.at(phase) != -1) samples << play.at(phase);
+        qSort(samples);
+
+        out << qSetFieldWidth(12) << left << phaseName(phase) << right << samples.size();
+        if (samples.isEmpty()) {
+            out << qSetFieldWidth(0) << "\n";
+            continue;
+        }
+        out << samples.at(samples.size() / 2)
+                << samples.at(samples.size() * 9 / 10)
+                << samples.last();
+
+        QVector<int> buckets(bucketCount + 1, 0);
+        foreach (int sample, samples) {
+            int bucket = 0;
+            while (bucket < bucketCount && sample >= bucketBounds[bucket]) bucket++;
+            buckets[bucket]++;
+        }
+        foreach (int count, buckets)
+            out << count;
+        out << qSetFieldWidth(0) << "\n";
+    }
+
+    return report;
+}
+
+QString PlaybackLatency::toCsv() const {
+    QStringList lines;
+
+    QStringList header;
+    for (int phase = 0; phase < PhaseCount; ++phase)
+        header << phaseName(phase);
+    lines << header.join(",");
+
+    foreach (QVector<int> play, plays) {
+        QStringList fields;
+        foreach (int ms, play)
+            fields << (ms == -1 ? QString() : QString::number(ms));
+        lines << fields.join(",");
+    }
+
+    return lines.join("\n") + "\n";
+}
+
+PlaybackLatencyDialog::PlaybackLatencyDialog(PlaybackLatency *latency, QWidget *parent) :
+        QDialog(parent), latency(latency) {
+    setWindowTitle(tr("Playback latency"));
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    text = new QPlainTextEdit(this);
+    text->setReadOnly(true);
+    text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    text->setFont(font);
+    text->setMinimumSize(720, 240);
+    layout->addWidget(text);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, Qt::Horizontal, this);
+    QPushButton *refreshButton = buttons->addButton(tr("Refresh"), QDialogButtonBox::ActionRole);
+    connect(refreshButton, SIGNAL(clicked()), SLOT(refresh()));
+    QPushButton *exportButton = buttons->addButton(tr("Export CSV..."), QDialogButtonBox::ActionRole);
+    connect(exportButton, SIGNAL(clicked()), SLOT(exportCsv()));
+    connect(buttons, SIGNAL(rejected()), SLOT(reject()));
+    layout->addWidget(buttons);
+
+    refresh();
+}
+
+void PlaybackLatencyDialog::refresh() {
+    text->setPlainText(latency->report());
+}
+
+void PlaybackLatencyDialog::exportCsv() {
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export CSV"),
+                                                    QDir::homePath() + "/playback-latency.csv",
+                                                    tr("CSV files (*.csv)"));
+    if (fileName.isEmpty()) return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QMessageBox::warning(this, windowTitle(), tr("Cannot write %1").arg(fileName));
+        return;
+    }
+    file.write(latency->toCsv().toUtf8());
+}
@@ -0,0 +1,67 @@
+#ifndef PLAYBACKLATENCY_H
+#define PLAYBACKLATENCY_H
+
+#include <QtGui>
+
+/**
+  * Times the phases of a play, from the row being activated to the first frame.
+  * The last plays are kept so that the distribution of each phase can be seen.
+  */
+class PlaybackLatency {
+
+public:
+    enum Phase {
+        Activated,
+        VideoId,
+        Token,
+        Definition,
+        StreamUrl,
+        SourceSet,
+        Buffering,
+        Playing,
+        PhaseCount
+    };
+
+    PlaybackLatency(int maxPlays = 100);
+
+    // a new play begins, the previous one is recorded as it is
+    void start();
+    // ms since start() the first time a phase is reached
+    void mark(Phase phase);
+
+    static QString phaseName(int phase);
+    // per phase percentiles and histogram, as plain text
+    QString report() const;
+    // one line per play, one column per phase
+    QString toCsv() const;
+
+private:
+    void finish();
+
+    int maxPlays;
+    QTime time;
+    bool running;
+    // ms for each phase, -1 if the play never reached it
+    QVector<int> currentPlay;
+    QList<QVector<int> > plays;
+
+};
+
+class PlaybackLatencyDialog : public QDialog {
+
+    Q_OBJECT
+
+public:
+    PlaybackLatencyDialog(PlaybackLatency *latency, QWidget *parent);
+
+private slots:
+    void refresh();
+    void exportCsv();
+
+private:
+    PlaybackLatency *latency;
+    QPlainTextEdit *text;
+
+};
+
+#endif // PLAYBACKLATENCY_H
@@ -4,16 +4,27 @@
 
 #include <QFontMetricsF>
 #include <QPainter>
+#include <QSettings>
 
 const qreal PrettyItemDelegate::THUMB_HEIGHT = 90.0;
 const qreal PrettyItemDelegate::THUMB_WIDTH = 120.0;
 const qreal PrettyItemDelegate::PADDING = 10.0;
 
 PrettyItemDelegate::PrettyItemDelegate( QObject* parent ) : QStyledItemDelegate( parent ) {
+    // comfortably more than the rows fitting on screen
+    layoutCache.setMaxCost(256);
+
+    // Rendering rows once and blitting them makes per pixel scrolling
+    // a lot smoother on slow, software rendered, graphics stacks
+    QSettings settings;
+    pixmapCacheEnabled = settings.value("playlistPixmapCache", false).toBool();
+    pixmapViewHeight = 0;
     boldFont.setBold(true);
     smallerBoldFont = FontUtils::smallBold();
     smallerFont = FontUtils::small();
     createPlayIcon();
+    // let videos download the thumbnail variant that fits our layout
+    Video::setThumbnailSize(QSize(THUMB_WIDTH, THUMB_HEIGHT));
 }
 
 void PrettyItemDelegate::createPlayIcon() {
@@ -46,17 +57,176 @@ void PrettyItemDelegate::paint( QPainter* painter,
 
     int itemType = index.data(ItemTypeRole).toInt();
     if (itemType == ItemTypeVideo) {
-        QApplication::style()->drawPrimitive( QStyle::PE_PanelItemViewItem, &option, painter );
-        paintBody( painter, option, index );
+        if (pixmapCacheEnabled) {
+            paintCached( painter, option, index );
+        } else {
+            QApplication::style()->drawPrimitive( QStyle::PE_PanelItemViewItem, &option, painter );
+            paintBody( painter, option, index );
+        }
     } else
         QStyledItemDelegate::paint( painter, option, index );
 
 }
 
+void PrettyItemDelegate::paintCached( QPainter* painter,
+                                      const QStyleOptionViewItem& option,
+                                      const QModelIndex& index ) const {
+
+    const ListModel *listModel = static_cast<const ListModel*>(index.model());
+    const Video *video = listModel->videoAt(index.row());
+    if (!video) return;
+
+    // keep just the rows on screen plus some margin
+    const QStyleOptionViewItemV3 *optionV3 = qstyleoption_cast<const QStyleOptionViewItemV3*>(&option);
+    if (optionV3 && optionV3->widget && optionV3->widget->height() != pixmapViewHeight) {
+        pixmapViewHeight = optionV3->widget->height();
+        const int visibleRows = pixmapViewHeight / option.rect.height() + 1;
+        rowPixmaps.setMaxCost(visibleRows * 2 + 10);
+    }
+
+    // Anything that changes the way the row looks must match.
+    // Changes to the video data drop the entry, see dataChanged()
+    const int state = option.state & (QStyle::State_Selected | QStyle::State_MouseOver
+                                      | QStyle::State_HasFocus | QStyle::State_Active
+                                      | QStyle::State_Enabled);
+    const bool isActive = index.data( ActiveTrackRole ).toBool();
+    const qint64 thumbnailKey = video->thumbnail().cacheKey();
+
+    RowPixmap *rowPixmap = rowPixmaps.object(video);
+    if (!rowPixmap
+        || rowPixmap->width != option.rect.width()
+        || rowPixmap->state != state
+        || rowPixmap->active != isActive
+        || rowPixmap->paletteKey != option.palette.cacheKey()
+        || rowPixmap->thumbnailKey != thumbnailKey
+        || rowPixmap->font != painter->font()) {
+        rowPixmap = new RowPixmap;
+        rowPixmap->width = option.rect.width();
+        rowPixmap->state = state;
+        rowPixmap->active = isActive;
+        rowPixmap->paletteKey = option.palette.cacheKey();
+        rowPixmap->thumbnailKey = thumbnailKey;
+        rowPixmap->font = painter->font();
+
+        QPixmap *pixmap = &rowPixmap->pixmap;
+        *pixmap = QPixmap(option.rect.size());
+        pixmap->fill(option.palette.color(QPalette::Base));
+
+        QStyleOptionViewItemV4 pixmapOption(option);
+        pixmapOption.rect = QRect(QPoint(0, 0), option.rect.size());
+
+        QPainter pixmapPainter(pixmap);
+        pixmapPainter.setFont(painter->font());
+        QApplication::style()->drawPrimitive( QStyle::PE_PanelItemViewItem, &pixmapOption, &pixmapPainter );
+        paintBody( &pixmapPainter, pixmapOption, index );
+        pixmapPainter.end();
+
+        painter->drawPixmap(option.rect.topLeft(), *pixmap);
+        rowPixmaps.insert(video, rowPixmap);
+        return;
+    }
+
+    painter->drawPixmap(option.rect.topLeft(), rowPixmap->pixmap);
+}
+
+const PrettyItemDelegate::RowLayout* PrettyItemDelegate::rowLayout(
+        const Video *video, int width, const QFont &font, bool isActive) const {
+
+    RowLayout *layout = layoutCache.object(video);
+    if (layout
+        && layout->width == width
+        && layout->active == isActive
+        && layout->font == font
+        && layout->title == video->title()
+        && layout->failureString == video->failureReason())
+        return layout;
+
+    layout = new RowLayout;
+    layout->width = width;
+    layout->active = isActive;
+    layout->font = font;
+    layout->title = video->title();
+    const QFont titleFont = isActive ? boldFont : font;
+
+    // title
+    const qreal titleWidth = width - THUMB_WIDTH - 3 * PADDING;
+    QTextOption textOption(Qt::AlignLeft | Qt::AlignTop);
+    textOption.setWrapMode(QTextOption::WordWrap);
+    layout->titleLayout.setText(layout->title);
+    layout->titleLayout.setFont(titleFont);
+    layout->titleLayout.setTextOption(textOption);
+    layout->titleHeight = 0;
+    layout->titleLayout.beginLayout();
+    forever {
+        QTextLine line = layout->titleLayout.createLine();
+        if (!line.isValid()) break;
+        line.setLineWidth(titleWidth);
+        line.setPosition(QPointF(0, layout->titleHeight));
+        layout->titleHeight += line.height();
+    }
+    layout->titleLayout.endLayout();
+
+    // time
+    int duration = video->duration();
+    if ( duration > 3600 )
+        layout->timeString = QTime().addSecs(duration).toString("h:mm:ss");
+    else
+        layout->timeString = QTime().addSecs(duration).toString("m:ss");
+    layout->timeSize = QFontMetricsF(font).size(Qt::TextSingleLine, layout->timeString);
+
+    // published date
+    layout->publishedString = video->published().date().toString(Qt::DefaultLocaleShortDate);
+    layout->publishedSize = QFontMetrics(smallerFont).size(Qt::TextSingleLine, layout->publishedString);
+
+    // author
+    layout->authorString = video->author();
+    layout->authorSize = QFontMetrics(smallerBoldFont).size(Qt::TextSingleLine, layout->authorString);
+
+    // view count
+    if (video->viewCount() >= 0) {
+        QLocale locale;
+        layout->viewCountString = tr("%1 views").arg(locale.toString(video->viewCount()));
+        layout->viewCountSize = QFontMetrics(smallerFont).size(Qt::TextSingleLine, layout->viewCountString);
+    }
+
+    // failure reason
+    layout->failureString = video->failureReason();
+    if (!layout->failureString.isEmpty())
+        layout->failureSize = QFontMetrics(smallerFont).size(Qt::TextSingleLine, layout->failureString);
+
+    // forget about the video as soon as it is gone
+    connect(video, SIGNAL(destroyed(QObject*)), SLOT(videoDestroyed(QObject*)), Qt::UniqueConnection);
+    layoutCache.insert(video, layout);
+    return layout;
+}
+
+void PrettyItemDelegate::videoDestroyed(QObject *video) {
+    layoutCache.remove(static_cast<const Video*>(video));
+    // a new video could reuse the same address
+    rowPixmaps.remove(static_cast<const Video*>(video));
+}
+
+void PrettyItemDelegate::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+    const ListModel *listModel = qobject_cast<const ListModel*>(topLeft.model());
+    if (!listModel) return;
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        const Video *video = listModel->videoAt(row);
+        if (!video) continue;
+        layoutCache.remove(video);
+        rowPixmaps.remove(video);
+    }
+}
+
 void PrettyItemDelegate::paintBody( QPainter* painter,
                                     const QStyleOptionViewItem& option,
                                     const QModelIndex& index ) const {
 
+    // get the video metadata
+    const ListModel *listModel = static_cast<const ListModel*>(index.model());
+    const Video *video = listModel->videoAt(index.row());
+    if (!video) return;
+
     painter->save();
     painter->translate( option.rect.topLeft() );
 
@@ -72,9 +242,7 @@ void PrettyItemDelegate::paintBody( QPainter* painter,
         paintActiveOverlay(painter, line.x(), line.y(), line.width(), line.height());
     }
 
-    // get the video metadata
-    const VideoPointer videoPointer = index.data( VideoRole ).value<VideoPointer>();
-    const Video *video = videoPointer.data();
+    const RowLayout *layout = rowLayout(video, option.rect.width(), painter->font(), isActive);
 
     // thumb
     if (!video->thumbnail().isNull()) {
@@ -85,19 +253,11 @@ void PrettyItemDelegate::paintBody( QPainter* painter,
             paintPlayIcon(painter);
 
         // time
-        QString timeString;
-        int duration = video->duration();
-        if ( duration > 3600 )
-            timeString = QTime().addSecs(duration).toString("h:mm:ss");
-        else
-            timeString = QTime().addSecs(duration).toString("m:ss");
-        drawTime(painter, timeString, line);
+        drawTime(painter, layout->timeString, layout->timeSize);
 
     }
 
     if (isActive) painter->setFont(boldFont);
-    const QFontMetricsF fm(painter->font());
-    const QFontMetricsF boldMetrics(boldFont);
 
     // text color
     if (isSelected)
@@ -106,42 +266,41 @@ void PrettyItemDelegate::paintBody( QPainter* painter,
         painter->setPen(QPen(option.palette.brush(QPalette::Text), 0));
 
     // title
-    QString videoTitle = video->title();
-    QRectF textBox = line.adjusted(PADDING+THUMB_WIDTH, PADDING, -2 * PADDING, -PADDING);
-    textBox = painter->boundingRect( textBox, Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, videoTitle);
-    painter->drawText(textBox, Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, videoTitle);
+    layout->titleLayout.draw(painter, QPointF(PADDING+THUMB_WIDTH, PADDING));
 
     painter->setFont(smallerFont);
 
-    // published date
-    QString publishedString = video->published().date().toString(Qt::DefaultLocaleShortDate);
-    QSizeF publishedStringSize(QFontMetrics(painter->font()).size( Qt::TextSingleLine, publishedString ) );
-    QPointF textLoc(PADDING+THUMB_WIDTH, PADDING*2 + textBox.height());
-    QRectF publishedTextBox( textLoc , publishedStringSize);
-    painter->drawText(publishedTextBox, Qt::AlignLeft | Qt::AlignTop, publishedString);
+    QPointF textLoc(PADDING+THUMB_WIDTH, PADDING*2 + layout->titleHeight);
 
-    // author
-    painter->save();
-    painter->setFont(smallerBoldFont);
-    if (!isSelected && !isActive)
-        painter->setPen(QPen(option.palette.brush(QPalette::Mid), 0));
-    QString authorString = video->author();
-    QSizeF authorStringSize(QFontMetrics(painter->font()).size( Qt::TextSingleLine, authorString ) );
-    textLoc.setX(textLoc.x() + publishedStringSize.width() + PADDING);
-    QRectF authorTextBox( textLoc , authorStringSize);
-    painter->drawText(authorTextBox, Qt::AlignLeft | Qt::AlignTop, authorString);
-    painter->restore();
+    // why it could not be played, instead of the details
+    if (!layout->failureString.isEmpty()) {
+        painter->save();
+        if (!isSelected) painter->setPen(QPen(QColor(Qt::red).darker(120), 0));
+        QRectF failureTextBox(textLoc, QSizeF(line.width() - textLoc.x() - PADDING, layout->failureSize.height()));
+        painter->drawText(failureTextBox, Qt::AlignLeft | Qt::AlignTop,
+                          painter->fontMetrics().elidedText(layout->failureString, Qt::ElideRight, failureTextBox.width()));
+        painter->restore();
+    } else {
+        // published date
+        QRectF publishedTextBox( textLoc , layout->publishedSize);
+        painter->drawText(publishedTextBox, Qt::AlignLeft | Qt::AlignTop, layout->publishedString);
 
-    // view count
-    if (video->viewCount() >= 0) {
+        // author
         painter->save();
-        QLocale locale;
-        QString viewCountString = tr("%1 views").arg(locale.toString(video->viewCount()));
-        QSizeF viewCountStringSize(QFontMetrics(painter->font()).size( Qt::TextSingleLine, viewCountString ) );
-        textLoc.setX(textLoc.x() + authorStringSize.width() + PADDING);
-        QRectF viewCountTextBox( textLoc , viewCountStringSize);
-        painter->drawText(viewCountTextBox, Qt::AlignLeft | Qt::AlignBottom, viewCountString);
+        painter->setFont(smallerBoldFont);
+        if (!isSelected && !isActive)
+            painter->setPen(QPen(option.palette.brush(QPalette::Mid), 0));
+        textLoc.setX(textLoc.x() + layout->publishedSize.width() + PADDING);
+        QRectF authorTextBox( textLoc , layout->authorSize);
+        painter->drawText(authorTextBox, Qt::AlignLeft | Qt::AlignTop, layout->authorString);
         painter->restore();
+
+        // view count
+        if (!layout->viewCountString.isEmpty()) {
+            textLoc.setX(textLoc.x() + layout->authorSize.width() + PADDING);
+            QRectF viewCountTextBox( textLoc , layout->viewCountSize);
+            painter->drawText(viewCountTextBox, Qt::AlignLeft | Qt::AlignBottom, layout->viewCountString);
+        }
     }
 
     /*
@@ -218,9 +377,9 @@ void PrettyItemDelegate::paintPlayIcon(QPainter *painter) const {
     painter->restore();
 }
 
-void PrettyItemDelegate::drawTime(QPainter *painter, QString time, QRectF line) const {
+void PrettyItemDelegate::drawTime(QPainter *painter, const QString &time, const QSizeF &timeSize) const {
     static const int timePadding = 4;
-    QRectF textBox = painter->boundingRect(line, Qt::AlignLeft | Qt::AlignTop, time);
+    QRectF textBox(QPointF(0, 0), timeSize);
     // add padding
     textBox.adjust(0, 0, timePadding, 0);
     // move to bottom right corner of the thumb
@@ -3,8 +3,11 @@
 
 #include <QModelIndex>
 #include <QStyledItemDelegate>
+#include <QTextLayout>
+#include <QCache>
 
 class QPainter;
+class Video;
 
 class PrettyItemDelegate : public QStyledItemDelegate {
 
@@ -17,8 +20,38 @@ public:
     QSize sizeHint( const QStyleOptionViewItem&, const QModelIndex& ) const;
     void paint( QPainter*, const QStyleOptionViewItem&, const QModelIndex& ) const;
 
+public slots:
+    // forget the cached rows whose data changed
+    void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
+private slots:
+    void videoDestroyed(QObject *video);
+
 private:
+    // Text layout and strings of a row, computed once and reused at every paint
+    struct RowLayout {
+        int width;
+        bool active;
+        QFont font;
+        QString title;
+        QTextLayout titleLayout;
+        qreal titleHeight;
+        QString timeString;
+        QSizeF timeSize;
+        QString publishedString;
+        QSizeF publishedSize;
+        QString authorString;
+        QSizeF authorSize;
+        QString viewCountString;
+        QSizeF viewCountSize;
+        // replaces the details line when the video could not be played
+        QString failureString;
+        QSizeF failureSize;
+    };
+    const RowLayout* rowLayout(const Video *video, int width, const QFont &font, bool isActive) const;
+
     void createPlayIcon();
+    void paintCached( QPainter*, const QStyleOptionViewItem&, const QModelIndex& ) const;
     void paintBody( QPainter*, const QStyleOptionViewItem&, const QModelIndex& ) const;
     QPointF centerImage( const QPixmap&, const QRectF& ) const;
 
@@ -27,7 +60,7 @@ private:
     void paintPlayIcon(QPainter *painter) const;
 
     //  Paints the video duration
-    void drawTime(QPainter *painter, QString time, QRectF line) const;
+    void drawTime(QPainter *painter, const QString &time, const QSizeF &timeSize) const;
 
     static const qreal THUMB_WIDTH;
     static const qreal THUMB_HEIGHT;
@@ -37,6 +70,23 @@ private:
     QFont boldFont;
     QFont smallerFont;
     QFont smallerBoldFont;
+
+    mutable QCache<const Video*, RowLayout> layoutCache;
+
+    // A fully rendered row and what it was rendered for, see paintCached()
+    struct RowPixmap {
+        QPixmap pixmap;
+        int width;
+        int state;
+        bool active;
+        qint64 paletteKey;
+        qint64 thumbnailKey;
+        QFont font;
+    };
+    bool pixmapCacheEnabled;
+    mutable QCache<const Video*, RowPixmap> rowPixmaps;
+    // the view height the cache size was computed for
+    mutable int pixmapViewHeight;
 };
 
 #endif
@@ -48,6 +48,7 @@
 #include "qtlocalpeer.h"
 #include <QtCore/QCoreApplication>
 #include <QtCore/QTime>
+#include <QtCore/QTimer>
 
 #if defined(Q_OS_WIN)
 #include <QtCore/QLibrary>
@@ -121,14 +122,10 @@ bool QtLocalPeer::isClient()
     if (!lockFile.lock(QtLP_Private::QtLockedFile::WriteLock, false))
         return true;
 
+    // The lock is released by the OS when its owner dies, so holding it
+    // means any socket left with our name belongs to a crashed instance
+    QLocalServer::removeServer(socketName);
     bool res = server->listen(socketName);
-#if defined(Q_OS_UNIX) && (QT_VERSION >= QT_VERSION_CHECK(4,5,0))
-    // ### Workaround
-    if (!res && server->serverError() == QAbstractSocket::AddressInUseError) {
-        QFile::remove(QDir::cleanPath(QDir::tempPath())+QLatin1Char('/')+socketName);
-        res = server->listen(socketName);
-    }
-#endif
     if (!res)
         qWarning("QtSingleCoreApplication: listen on local socket failed, %s", qPrintable(server->errorString()));
     QObject::connect(server, SIGNAL(newConnection()), SLOT(receiveConnection()));
@@ -136,20 +133,28 @@ bool QtLocalPeer::isClient()
 }
 
 
+/*
+  The timeout bounds the whole exchange, not each step, so a primary
+  instance that is busy or still starting up cannot stall the caller
+  for longer than that.
+*/
 bool QtLocalPeer::sendMessage(const QString &message, int timeout)
 {
     if (!isClient())
         return false;
 
+    QTime time;
+    time.start();
+
     QLocalSocket socket;
     bool connOk = false;
     for(int i = 0; i < 2; i++) {
         // Try twice, in case the other instance is just starting up
         socket.connectToServer(socketName);
-        connOk = socket.waitForConnected(timeout/2);
-        if (connOk || i)
+        connOk = socket.waitForConnected(qMax(1, timeout/2 - time.elapsed()));
+        if (connOk || i || time.elapsed() >= timeout/2)
             break;
-        int ms = 250;
+        int ms = 100;
 #if defined(Q_OS_WIN)
         Sleep(DWORD(ms));
 #else
@@ -163,41 +168,65 @@ bool QtLocalPeer::sendMessage(const QString &message, int timeout)
     QByteArray uMsg(message.toUtf8());
     QDataStream ds(&socket);
     ds.writeBytes(uMsg.constData(), uMsg.size());
-    bool res = socket.waitForBytesWritten(timeout);
-    res &= socket.waitForReadyRead(timeout);   // wait for ack
+    bool res = socket.waitForBytesWritten(qMax(1, timeout - time.elapsed()));
+    // wait for ack
+    while (res && socket.bytesAvailable() < (int)qstrlen(ack))
+        res = socket.waitForReadyRead(qMax(1, timeout - time.elapsed()));
     res &= (socket.read(qstrlen(ack)) == ack);
     return res;
 }
 
 
+/*
+  Incoming messages are read as their bytes arrive,
+  the GUI thread never waits on a slow or dead client.
+*/
 void QtLocalPeer::receiveConnection()
 {
     QLocalSocket* socket = server->nextPendingConnection();
     if (!socket)
         return;
 
-    while (socket->bytesAvailable() < (int)sizeof(quint32))
-        socket->waitForReadyRead();
-    QDataStream ds(socket);
-    QByteArray uMsg;
+    connect(socket, SIGNAL(readyRead()), SLOT(socketReadyRead()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    // a client that does not complete its message in time is dropped
+    QTimer::singleShot(5000, socket, SLOT(deleteLater()));
+
+    // some bytes may have arrived already
+    readMessage(socket);
+}
+
+
+void QtLocalPeer::socketReadyRead()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    if (socket)
+        readMessage(socket);
+}
+
+
+void QtLocalPeer::readMessage(QLocalSocket *socket)
+{
+    // the message is a quint32 length followed by the UTF-8 bytes
+    if (socket->bytesAvailable() < (int)sizeof(quint32))
+        return;
+    QByteArray header = socket->peek(sizeof(quint32));
+    QDataStream hs(header);
     quint32 remaining;
-    ds >> remaining;
-    uMsg.resize(remaining);
-    int got = 0;
-    char* uMsgBuf = uMsg.data();
-    do {
-        got = ds.readRawData(uMsgBuf, remaining);
-        remaining -= got;
-        uMsgBuf += got;
-    } while (remaining && got >= 0 && socket->waitForReadyRead(2000));
-    if (got < 0) {
-        qWarning() << "QtLocalPeer: Message reception failed" << socket->errorString();
-        delete socket;
+    hs >> remaining;
+    if (remaining > 1024 * 1024) {
+        qWarning() << "QtLocalPeer: Message too long" << remaining;
+        socket->abort();
         return;
     }
+    if (socket->bytesAvailable() < (qint64)(sizeof(quint32) + remaining))
+        return;
+
+    socket->read(sizeof(quint32));
+    QByteArray uMsg = socket->read(remaining);
     QString message(QString::fromUtf8(uMsg));
     socket->write(ack, qstrlen(ack));
-    socket->waitForBytesWritten(1000);
-    delete socket;
+    // pending bytes are written before the connection closes
+    socket->disconnectFromServer();
     emit messageReceived(message); //### (might take a long time to return)
 }
@@ -69,6 +69,7 @@ Q_SIGNALS:
 
 protected Q_SLOTS:
     void receiveConnection();
+    void socketReadyRead();
 
 protected:
     QString id;
@@ -77,5 +78,7 @@ protected:
     QtLP_Private::QtLockedFile lockFile;
 
 private:
+    void readMessage(QLocalSocket *socket);
+
     static const char* ack;
 };
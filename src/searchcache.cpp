@@ -0,0 +1,98 @@
+#include "searchcache.h"
+
+SearchCache::SearchCache(qint64 maxSize, int timeToLive) :
+        maxSize(maxSize),
+        totalSize(0),
+        timeToLive(timeToLive) { }
+
+SearchCache::~SearchCache() {
+    foreach (Page page, pages.values())
+        qDeleteAll(page.videos);
+}
+
+QString SearchCache::key(const QString &keywords, int sortBy, int start, int max) {
+    return QString("%1|%2|%3|%4").arg(keywords, QString::number(sortBy),
+                                       QString::number(start), QString::number(max));
+}
+
+bool SearchCache::contains(const QString &key) {
+    if (!pages.contains(key)) return false;
+
+    uint now = QDateTime::currentDateTime().toTime_t();
+    if (now - pages.value(key).time > (uint) timeToLive) {
+        remove(key);
+        return false;
+    }
+    return true;
+}
+
+bool SearchCache::page(const QString &key, QList<Video*> &videos) {
+    if (!contains(key)) return false;
+
+    const Page &page = pages[key];
+
+    videos.clear();
+    foreach (Video *video, page.videos)
+        videos << video->clone();
+
+    keys.removeOne(key);
+    keys << key;
+    return true;
+}
+
+void SearchCache::insert(const QString &key, const QList<Video*> &videos) {
+    if (pages.contains(key)) remove(key);
+
+    Page page;
+    page.time = QDateTime::currentDateTime().toTime_t();
+    page.size = 0;
+    foreach (Video *video, videos) {
+        Video *copy = video->clone();
+        page.videos << copy;
+        page.size += copy->memoryUsage();
+    }
+
+    pages.insert(key, page);
+    keys << key;
+    totalSize += page.size;
+
+    evict();
+}
+
+void SearchCache::updateThumbnails(const QList<Video*> &videos) {
+    QHash<QString, Video*> loaded;
+    foreach (Video *video, videos) {
+        if (!video->thumbnail().isNull() && !video->id().isEmpty())
+            loaded.insert(video->id(), video);
+    }
+    if (loaded.isEmpty()) return;
+
+    // swap in fresh copies of the videos whose thumbnail was loaded meanwhile
+    QMutableHashIterator<QString, Page> it(pages);
+    while (it.hasNext()) {
+        Page &page = it.next().value();
+        for (int i = 0; i < page.videos.size(); i++) {
+            Video *copy = page.videos.at(i);
+            if (!copy->thumbnail().isNull() || !loaded.contains(copy->id())) continue;
+            Video *updated = loaded.value(copy->id())->clone();
+            page.size += updated->memoryUsage() - copy->memoryUsage();
+            totalSize += updated->memoryUsage() - copy->memoryUsage();
+            page.videos[i] = updated;
+            delete copy;
+        }
+    }
+
+    evict();
+}
+
+void SearchCache::remove(const QString &key) {
+    Page page = pages.take(key);
+    keys.removeOne(key);
+    totalSize -= page.size;
+    qDeleteAll(page.videos);
+}
+
+void SearchCache::evict() {
+    while (totalSize > maxSize && keys.size() > 1)
+        remove(keys.first());
+}
@@ -0,0 +1,43 @@
+#ifndef SEARCHCACHE_H
+#define SEARCHCACHE_H
+
+#include "video.h"
+
+/**
+  * In-memory LRU cache of parsed search result pages,
+  * keyed by keywords, sort order, start index and page size.
+  * The cache owns copies of the videos and hands out new copies,
+  * so models are free to delete what they get.
+  */
+class SearchCache {
+
+public:
+    SearchCache(qint64 maxSize, int timeToLive);
+    ~SearchCache();
+    static QString key(const QString &keywords, int sortBy, int start, int max);
+    bool contains(const QString &key);
+    bool page(const QString &key, QList<Video*> &videos);
+    void insert(const QString &key, const QList<Video*> &videos);
+    void updateThumbnails(const QList<Video*> &videos);
+
+private:
+    struct Page {
+        QList<Video*> videos;
+        uint time;
+        qint64 size;
+    };
+    void remove(const QString &key);
+    void evict();
+
+    qint64 maxSize;
+    qint64 totalSize;
+    // in seconds
+    int timeToLive;
+
+    QHash<QString, Page> pages;
+    // keys ordered from the least to the most recently used
+    QStringList keys;
+
+};
+
+#endif // SEARCHCACHE_H
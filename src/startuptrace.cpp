@@ -0,0 +1,31 @@
+#include "startuptrace.h"
+#include <QtCore>
+
+static QTime startupTime;
+static QList<QPair<QString, int> > phases;
+static bool dumped = false;
+
+static bool isEnabled() {
+    static const bool enabled = !qgetenv("MINITUBE_TRACE_STARTUP").isEmpty();
+    return enabled;
+}
+
+void StartupTrace::mark(const QString &phase) {
+    if (!isEnabled() || dumped) return;
+    if (phases.isEmpty()) startupTime.start();
+    phases << qMakePair(phase, startupTime.elapsed());
+}
+
+void StartupTrace::dump() {
+    if (!isEnabled() || dumped) return;
+    dumped = true;
+
+    int previous = 0;
+    for (int i = 0; i < phases.size(); ++i) {
+        const QPair<QString, int> &phase = phases.at(i);
+        qDebug() << "Startup" << qPrintable(phase.first)
+                << phase.second << "ms" << "(+" << phase.second - previous << "ms)";
+        previous = phase.second;
+    }
+    phases.clear();
+}
@@ -0,0 +1,21 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QString>
+
+/**
+  * Timestamps of the startup phases.
+  * Enabled by setting the MINITUBE_TRACE_STARTUP environment variable,
+  * otherwise marks are ignored.
+  */
+class StartupTrace {
+
+public:
+    // Records the time elapsed since the first mark
+    static void mark(const QString &phase);
+    // Prints the recorded phases, only the first call does
+    static void dump();
+
+};
+
+#endif // STARTUPTRACE_H
@@ -0,0 +1,102 @@
+#include "thumbnailstore.h"
+
+static const quint32 MAGIC = 0x4d545448; // "MTTH"
+static const int HEADER_SIZE = 16;
+static const QString SUFFIX = ".thumb";
+
+ThumbnailStore::ThumbnailStore(QString location, qint64 maxSize) :
+        maxSize(maxSize),
+        totalSize(0) {
+
+    dir.mkpath(location);
+    dir.setPath(location);
+
+    // we cannot rely on access times,
+    // so modification time is the best guess for the initial LRU order
+    QFileInfoList files = dir.entryInfoList(QStringList("*" + SUFFIX), QDir::Files, QDir::Time | QDir::Reversed);
+    foreach (QFileInfo fileInfo, files) {
+        QString key = fileInfo.completeBaseName();
+        keys << key;
+        sizes.insert(key, fileInfo.size());
+        totalSize += fileInfo.size();
+    }
+
+    evict();
+}
+
+QString ThumbnailStore::key(const QString &videoId, QSize size) {
+    return QString("%1-%2x%3").arg(videoId, QString::number(size.width()), QString::number(size.height()));
+}
+
+QString ThumbnailStore::fileName(const QString &key) const {
+    return dir.filePath(key + SUFFIX);
+}
+
+QImage ThumbnailStore::load(const QString &key) {
+    if (!sizes.contains(key)) return QImage();
+
+    QFile file(fileName(key));
+    if (!file.open(QIODevice::ReadOnly) || file.size() < HEADER_SIZE) return QImage();
+
+    uchar *bytes = file.map(0, file.size());
+    if (!bytes) return QImage();
+
+    QDataStream header(QByteArray::fromRawData(reinterpret_cast<const char*>(bytes), HEADER_SIZE));
+    quint32 magic;
+    quint16 width, height;
+    quint32 bytesPerLine;
+    header >> magic >> width >> height >> bytesPerLine;
+
+    QImage image;
+    if (magic == MAGIC && HEADER_SIZE + bytesPerLine * height <= file.size()) {
+        // the mapped memory goes away with the file, so take a copy
+        image = QImage(bytes + HEADER_SIZE, width, height, bytesPerLine, QImage::Format_RGB888)
+                .convertToFormat(QImage::Format_RGB32);
+        touch(key);
+    } else {
+        qDebug() << "Invalid thumbnail file" << file.fileName();
+    }
+
+    file.unmap(bytes);
+    return image;
+}
+
+void ThumbnailStore::store(const QString &key, const QImage &image) {
+    if (image.isNull()) return;
+    QImage rgbImage = image.convertToFormat(QImage::Format_RGB888);
+
+    QFile file(fileName(key));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Cannot write thumbnail" << file.fileName() << file.errorString();
+        return;
+    }
+
+    QDataStream header(&file);
+    header << MAGIC
+            << (quint16) rgbImage.width()
+            << (quint16) rgbImage.height()
+            << (quint32) rgbImage.bytesPerLine()
+            << (quint32) 0;
+    file.write(reinterpret_cast<const char*>(rgbImage.bits()), rgbImage.numBytes());
+    file.close();
+
+    totalSize -= sizes.value(key, 0);
+    sizes.insert(key, file.size());
+    totalSize += file.size();
+    touch(key);
+
+    evict();
+}
+
+void ThumbnailStore::touch(const QString &key) {
+    keys.removeOne(key);
+    keys << key;
+}
+
+void ThumbnailStore::evict() {
+    while (totalSize > maxSize && !keys.isEmpty()) {
+        QString key = keys.takeFirst();
+        QFile::remove(fileName(key));
+        totalSize -= sizes.take(key);
+    }
+}
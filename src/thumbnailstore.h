@@ -0,0 +1,36 @@
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QtGui>
+
+/**
+  * On-disk store of pre-scaled thumbnails.
+  * Images are saved as raw RGB888 scanlines behind a small header
+  * so that loading one is just a memory map and a copy.
+  * The least recently used files are evicted when the store grows
+  * beyond its maximum size.
+  */
+class ThumbnailStore {
+
+public:
+    ThumbnailStore(QString location, qint64 maxSize);
+    QImage load(const QString &key);
+    void store(const QString &key, const QImage &image);
+    static QString key(const QString &videoId, QSize size);
+
+private:
+    QString fileName(const QString &key) const;
+    void touch(const QString &key);
+    void evict();
+
+    QDir dir;
+    qint64 maxSize;
+    qint64 totalSize;
+
+    // keys ordered from the least to the most recently used
+    QStringList keys;
+    QHash<QString, qint64> sizes;
+
+};
+
+#endif // THUMBNAILSTORE_H
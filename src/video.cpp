@@ -2,24 +2,188 @@
 #include "networkaccess.h"
 #include <QtNetwork>
 #include "videodefinition.h"
+#include "thumbnailstore.h"
+#include "bandwidthestimator.h"
 
 namespace The {
     NetworkAccess* http();
+    ThumbnailStore* thumbnailStore();
+    BandwidthEstimator* bandwidthEstimator();
 }
 
-Video::Video() : m_duration(0),
+QSize Video::m_thumbnailSize = QSize(120, 90);
+
+Video::Video() : m_thumbnailFailed(false),
+m_duration(0),
 m_viewCount(-1),
 definitionCode(0),
-elIndex(0) { }
+maxDefinitionCode(0),
+elIndex(0),
+m_compacted(false) { }
+
+Video::~Video() {
+    // nobody is going to look at this thumbnail anymore
+    cancelThumbnail();
+}
+
+Video* Video::clone() {
+    Video* cloneVideo = new Video();
+    cloneVideo->m_id = m_id;
+    cloneVideo->m_title = m_title;
+    cloneVideo->m_description = m_description;
+    cloneVideo->m_author = m_author;
+    cloneVideo->m_webpage = m_webpage;
+    cloneVideo->m_thumbnail = m_thumbnail;
+    cloneVideo->m_thumbnailUrls = m_thumbnailUrls;
+    cloneVideo->m_thumbnailSizes = m_thumbnailSizes;
+    cloneVideo->m_duration = m_duration;
+    cloneVideo->m_published = m_published;
+    cloneVideo->m_viewCount = m_viewCount;
+    return cloneVideo;
+}
+
+void Video::compact() {
+    // only once, a thumbnail reloaded since then is on screen
+    if (m_compacted) return;
+    m_compacted = true;
+    cancelThumbnail();
+    // the thumbnail store or the network will give it back when the row is shown
+    unloadThumbnail();
+    // keep enough for the loading screen
+    if (m_description.size() > 200)
+        m_description = m_description.left(200) + "...";
+    m_streamUrl.clear();
+    videoToken.clear();
+    definitionCode = 0;
+    elIndex = 0;
+}
+
+int Video::memoryUsage() const {
+    return sizeof(Video)
+            + (m_title.size() + m_description.size() + m_author.size() + videoToken.size()) * sizeof(QChar)
+            + m_thumbnail.numBytes();
+}
+
+VideoRecord Video::record() const {
+    VideoRecord record;
+    record.id = m_id;
+    record.webpage = m_webpage.toString();
+    record.title = m_title;
+    record.author = m_author;
+    record.description = m_description.size() > 200 ? m_description.left(200) + "..." : m_description;
+    record.thumbnailUrl = thumbnailUrlFor(m_thumbnailSize).toString();
+    record.failureReason = m_failureReason;
+    record.duration = m_duration;
+    record.viewCount = m_viewCount;
+    if (m_published.isValid()) record.published = m_published.toTime_t();
+    record.thumbnailFailed = m_thumbnailFailed;
+    return record;
+}
+
+Video* Video::fromRecord(const VideoRecord &record) {
+    Video* video = new Video();
+    // the id was parsed from this webpage already
+    video->m_id = record.id;
+    video->m_webpage = QUrl(record.webpage);
+    video->m_title = record.title;
+    video->m_author = record.author;
+    video->m_description = record.description;
+    if (!record.thumbnailUrl.isEmpty())
+        video->addThumbnailUrl(QUrl(record.thumbnailUrl), m_thumbnailSize);
+    video->m_failureReason = record.failureReason;
+    video->m_duration = record.duration;
+    video->m_viewCount = record.viewCount;
+    if (record.published) video->m_published = QDateTime::fromTime_t(record.published);
+    video->m_thumbnailFailed = record.thumbnailFailed;
+    return video;
+}
+
+int VideoRecord::memoryUsage() const {
+    return (id.size() + webpage.size() + title.size() + author.size() + description.size()
+            + thumbnailUrl.size() + failureReason.size()) * sizeof(QChar);
+}
+
+QUrl Video::thumbnailUrlFor(QSize size) const {
+    if (m_thumbnailUrls.isEmpty()) return QUrl();
+
+    // pick the smallest variant that covers the requested size.
+    // If none does, fall back to the largest one we know of.
+    int bestIndex = -1;
+    int largestIndex = -1;
+    for (int i = 0; i < m_thumbnailSizes.size(); i++) {
+        const QSize variantSize = m_thumbnailSizes.at(i);
+        if (variantSize.isEmpty()) continue;
+        const int area = variantSize.width() * variantSize.height();
+        if (variantSize.width() >= size.width() && variantSize.height() >= size.height()) {
+            if (bestIndex == -1 || area < m_thumbnailSizes.at(bestIndex).width() * m_thumbnailSizes.at(bestIndex).height())
+                bestIndex = i;
+        }
+        if (largestIndex == -1 || area > m_thumbnailSizes.at(largestIndex).width() * m_thumbnailSizes.at(largestIndex).height())
+            largestIndex = i;
+    }
+
+    if (bestIndex != -1) return m_thumbnailUrls.at(bestIndex);
+    if (largestIndex != -1) return m_thumbnailUrls.at(largestIndex);
+    return m_thumbnailUrls.first();
+}
+
+void Video::setWebpage(QUrl webpage) {
+    m_webpage = webpage;
+
+    // Get Video ID
+    // youtube-dl line 428
+    // QRegExp re("^((?:http://)?(?:\\w+\\.)?youtube\\.com/(?:(?:v/)|(?:(?:watch(?:\\.php)?)?\\?(?:.+&)?v=)))?([0-9A-Za-z_-]+)(?(1).+)?$");
+    QRegExp re("^http://www\\.youtube\\.com/watch\\?v=([0-9A-Za-z_-]+).*");
+    if (re.exactMatch(m_webpage.toString()) && re.numCaptures() >= 1)
+        m_id = re.cap(1);
+    else
+        m_id.clear();
+}
 
 void Video::preloadThumbnail() {
-    if (m_thumbnailUrls.isEmpty()) return;
-    QObject *reply = The::http()->get(m_thumbnailUrls.first());
-    connect(reply, SIGNAL(data(QByteArray)), SLOT(setThumbnail(QByteArray)));
+    if (!m_thumbnail.isNull() || thumbnailReply || m_thumbnailFailed) return;
+
+    // seen this one before?
+    if (!m_id.isEmpty()) {
+        QImage image = The::thumbnailStore()->load(ThumbnailStore::key(m_id, m_thumbnailSize));
+        if (!image.isNull()) {
+            m_thumbnail = image;
+            emit gotThumbnail();
+            return;
+        }
+    }
+
+    QUrl url = thumbnailUrlFor(m_thumbnailSize);
+    if (url.isEmpty()) return;
+    thumbnailReply = The::http()->get(url);
+    connect(thumbnailReply, SIGNAL(data(QByteArray)), SLOT(setThumbnail(QByteArray)));
+}
+
+void Video::cancelThumbnail() {
+    if (!thumbnailReply) return;
+    thumbnailReply->abort();
+    thumbnailReply = 0;
+}
+
+void Video::unloadThumbnail() {
+    m_thumbnail = QImage();
 }
 
 void Video::setThumbnail(QByteArray bytes) {
-    m_thumbnail = QImage::fromData(bytes);
+    thumbnailReply = 0;
+    QImage image = QImage::fromData(bytes);
+    // most likely an error page, the row keeps no thumbnail for this search
+    if (image.isNull()) {
+        qDebug() << "Cannot decode thumbnail for" << m_id;
+        m_thumbnailFailed = true;
+        return;
+    }
+    // scale once here instead of at every paint
+    if (image.width() > m_thumbnailSize.width() || image.height() > m_thumbnailSize.height())
+        image = image.scaled(m_thumbnailSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    m_thumbnail = image;
+    if (!m_id.isEmpty())
+        The::thumbnailStore()->store(ThumbnailStore::key(m_id, m_thumbnailSize), m_thumbnail);
     emit gotThumbnail();
 }
 
@@ -31,17 +195,16 @@ void Video::loadStreamUrl() {
 
     // https://develop.participatoryculture.org/trac/democracy/browser/trunk/tv/portable/flashscraper.py
 
-    // Get Video ID
-    // youtube-dl line 428
-    // QRegExp re("^((?:http://)?(?:\\w+\\.)?youtube\\.com/(?:(?:v/)|(?:(?:watch(?:\\.php)?)?\\?(?:.+&)?v=)))?([0-9A-Za-z_-]+)(?(1).+)?$");
-    QRegExp re("^http://www\\.youtube\\.com/watch\\?v=([0-9A-Za-z_-]+).*");
-    bool match = re.exactMatch(m_webpage.toString());
-    if (!match || re.numCaptures() < 1) {
+    // the video id is parsed in setWebpage()
+    if (m_id.isEmpty()) {
         emit errorStreamUrl(QString("Cannot get video id for %1").arg(m_webpage.toString()));
         return;
     }
-    videoId = re.cap(1);
 
+    // always start over with a fresh token
+    elIndex = 0;
+    videoToken.clear();
+    m_streamUrl.clear();
     getVideoInfo();
 
 }
@@ -63,7 +226,7 @@ void Video::getVideoInfo() {
     // Get Video Token
     QUrl videoInfoUrl = QUrl(QString(
             "http://www.youtube.com/get_video_info?video_id=%1%2&ps=default&eurl=&gl=US&hl=en"
-            ).arg(videoId, elTypes.at(elIndex)));
+            ).arg(m_id, elTypes.at(elIndex)));
 
     QObject *reply = The::http()->get(videoInfoUrl);
 
@@ -92,6 +255,7 @@ void  Video::gotVideoInfo(QByteArray data) {
         videoToken = QByteArray::fromPercentEncoding(videoToken.toAscii());
     qDebug() << "videoToken" << videoToken;
     this->videoToken = videoToken;
+    emit gotVideoToken();
 
     /*
     // get fmt_url_map
@@ -120,9 +284,7 @@ void  Video::gotVideoInfo(QByteArray data) {
     }
     */
 
-    QSettings settings;
-    QString definitionName = settings.value("definition").toString();
-    int definitionCode = VideoDefinition::getDefinitionCode(definitionName);
+    int definitionCode = requestedDefinitionCode();
     if (definitionCode == 18) {
         // This is assumed always available
         foundVideoUrl(videoToken, 18);
@@ -132,13 +294,40 @@ void  Video::gotVideoInfo(QByteArray data) {
 
 }
 
+int Video::requestedDefinitionCode() const {
+    QSettings settings;
+    QString definitionName = settings.value("definition").toString();
+    int definitionCode;
+    if (definitionName == VideoDefinition::autoDefinitionName())
+        definitionCode = The::bandwidthEstimator()->definitionCode();
+    else
+        definitionCode = VideoDefinition::getDefinitionCode(definitionName);
+    if (maxDefinitionCode) {
+        // codes are not ordered, their position in the list is
+        const QList<int> definitionCodes = VideoDefinition::getDefinitionCodes();
+        if (definitionCodes.indexOf(definitionCode) > definitionCodes.indexOf(maxDefinitionCode))
+            definitionCode = maxDefinitionCode;
+    }
+    return definitionCode;
+}
+
+bool Video::lowerDefinition() {
+    const QList<int> definitionCodes = VideoDefinition::getDefinitionCodes();
+    const int index = definitionCodes.indexOf(definitionCode ? definitionCode : requestedDefinitionCode());
+    if (index <= 0) return false;
+    maxDefinitionCode = definitionCodes.at(index - 1);
+    return true;
+}
+
 void Video::foundVideoUrl(QString videoToken, int definitionCode) {
+    this->definitionCode = definitionCode;
 
     QUrl videoUrl = QUrl(QString(
             "http://www.youtube.com/get_video?video_id=%1&t=%2&eurl=&el=&ps=&asv=&fmt=%3"
-            ).arg(videoId, videoToken, QString::number(definitionCode)));
+            ).arg(m_id, videoToken, QString::number(definitionCode)));
 
     m_streamUrl = videoUrl;
+    emit gotDefinition(definitionCode);
     emit gotStreamUrl(videoUrl);
 }
 
@@ -165,12 +354,11 @@ void Video::scrapeWebPage(QByteArray data) {
 
     // we'll need this in gotHeadHeaders()
     this->videoToken = videoToken;
+    emit gotVideoToken();
 
     // qDebug() << "token" << videoToken;
 
-    QSettings settings;
-    QString definitionName = settings.value("definition").toString();
-    int definitionCode = VideoDefinition::getDefinitionCode(definitionName);
+    int definitionCode = requestedDefinitionCode();
     if (definitionCode == 18) {
         // This is assumed always available
         foundVideoUrl(videoToken, 18);
@@ -228,7 +416,7 @@ void Video::findVideoUrl(int definitionCode) {
 
     QUrl videoUrl = QUrl(QString(
             "http://www.youtube.com/get_video?video_id=%1&t=%2&eurl=&el=&ps=&asv=&fmt=%3"
-            ).arg(videoId, videoToken, QString::number(definitionCode)));
+            ).arg(m_id, videoToken, QString::number(definitionCode)));
 
     QObject *reply = The::http()->head(videoUrl);
     connect(reply, SIGNAL(finished(QNetworkReply*)), SLOT(gotHeadHeaders(QNetworkReply*)));
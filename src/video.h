@@ -4,12 +4,51 @@
 #include <QtGui>
 #include <QtNetwork>
 
+class NetworkReply;
+
+/**
+  * What the playlist keeps of a video that is neither on screen nor playing:
+  * enough to paint its row and to create the Video again
+  */
+struct VideoRecord {
+    VideoRecord() : duration(0), viewCount(-1), published(0), thumbnailFailed(false) { }
+    // bytes held by the strings, the struct itself aside
+    int memoryUsage() const;
+
+    QString id;
+    QString webpage;
+    QString title;
+    QString author;
+    // truncated like in Video::compact()
+    QString description;
+    // the variant for the thumbnail display size
+    QString thumbnailUrl;
+    QString failureReason;
+    int duration;
+    int viewCount;
+    // seconds since the epoch, 0 if unknown
+    uint published;
+    bool thumbnailFailed;
+};
+
 class Video : public QObject {
 
     Q_OBJECT
 
 public:
     Video();
+    ~Video();
+    // A copy of the metadata and thumbnail, without any stream state
+    Video* clone();
+    // Releases what can be reloaded later: the thumbnail, most of the description
+    // and the stream resolution state
+    void compact();
+    bool isCompacted() const { return m_compacted; }
+    // A rough estimate of the memory held by this video, in bytes
+    int memoryUsage() const;
+    // The metadata the playlist keeps once this video is deleted
+    VideoRecord record() const;
+    static Video* fromRecord(const VideoRecord &record);
 
     const QString title() const { return m_title; }
     void setTitle( QString title ) { m_title = title; }
@@ -21,14 +60,28 @@ public:
     void setAuthor( QString author ) { m_author = author; }
 
     const QUrl webpage() const { return m_webpage; }
-    void setWebpage( QUrl webpage ) { m_webpage = webpage; }
+    void setWebpage( QUrl webpage );
+
+    // The YouTube video id, empty if the webpage is not a YouTube one
+    const QString id() const { return m_id; }
 
     QList<QUrl> thumbnailUrls() const { return m_thumbnailUrls; }
-    void addThumbnailUrl(QUrl url) {
+    void addThumbnailUrl(QUrl url, QSize size = QSize()) {
         m_thumbnailUrls << url;
+        m_thumbnailSizes << size;
     }
+    QUrl thumbnailUrlFor(QSize size) const;
+
+    // The size thumbnails are displayed at
+    static QSize thumbnailSize() { return m_thumbnailSize; }
+    static void setThumbnailSize(QSize size) { m_thumbnailSize = size; }
 
     void preloadThumbnail();
+    void cancelThumbnail();
+    // Frees the thumbnail image, preloadThumbnail() gets it back from the store
+    void unloadThumbnail();
+    bool isThumbnailLoading() const { return !thumbnailReply.isNull(); }
+    bool isThumbnailFailed() const { return m_thumbnailFailed; }
     const QImage thumbnail() const;
 
     int duration() const { return m_duration; }
@@ -40,7 +93,16 @@ public:
     const QDateTime published() const { return m_published; }
     void setPublished( QDateTime published ) { m_published = published; }
 
-    bool getDefinitionCode() const { return definitionCode; }
+    int getDefinitionCode() const { return definitionCode; }
+    // Caps the definition of the next loadStreamUrl() to the one below the last used.
+    // Returns false if there is nothing lower.
+    bool lowerDefinition();
+    // back to the user setting
+    void resetDefinition() { maxDefinitionCode = 0; }
+
+    // why this video could not be played, empty if it never failed
+    const QString failureReason() const { return m_failureReason; }
+    void setFailureReason(QString reason) { m_failureReason = reason; }
 
     void loadStreamUrl();
     QUrl getStreamUrl() { return m_streamUrl; }
@@ -50,6 +112,9 @@ public slots:
 
 signals:
     void gotThumbnail();
+    // loading progress, before gotStreamUrl()
+    void gotVideoToken();
+    void gotDefinition(int definitionCode);
     void gotStreamUrl(QUrl streamUrl);
     void errorStreamUrl(QString message);
 
@@ -63,7 +128,9 @@ private:
     void getVideoInfo();
     void findVideoUrl(int definitionCode);
     void foundVideoUrl(QString videoToken, int definitionCode);
+    int requestedDefinitionCode() const;
 
+    QString m_id;
     QString m_title;
     QString m_description;
     QString m_author;
@@ -71,20 +138,28 @@ private:
     QUrl m_streamUrl;
     QImage m_thumbnail;
     QList<QUrl> m_thumbnailUrls;
+    // sizes of the thumbnail variants, empty if unknown
+    QList<QSize> m_thumbnailSizes;
+    static QSize m_thumbnailSize;
+    // the pending thumbnail request, if any
+    QPointer<NetworkReply> thumbnailReply;
+    // the thumbnail could not be decoded, do not ask again
+    bool m_thumbnailFailed;
     int m_duration;
     QDateTime m_published;
     int m_viewCount;
 
-    // The YouTube video id
-    // This is needed by the gotVideoInfo callback
-    QString videoId;
-
     QString videoToken;
     int definitionCode;
+    // the highest definition to try, 0 for the user setting
+    int maxDefinitionCode;
+    QString m_failureReason;
 
     // current index for the elTypes list
     // needed to iterate on elTypes
     int elIndex;
+
+    bool m_compacted;
 };
 
 // This is required in order to use QPointer<Video> as a QVariant
@@ -1,7 +1,7 @@
 #include "videodefinition.h"
 
 QStringList VideoDefinition::getDefinitionNames() {
-    static QStringList definitionNames = QStringList() << "360p" << "720p" << "1080p";
+    static QStringList definitionNames = QStringList() << "360p" << "720p" << "1080p" << autoDefinitionName();
     return definitionNames;
 }
 
@@ -23,3 +23,7 @@ QHash<QString, int> VideoDefinition::getDefinitions() {
 int VideoDefinition::getDefinitionCode(QString name) {
     return VideoDefinition::getDefinitions().value(name);
 }
+
+QString VideoDefinition::autoDefinitionName() {
+    return "Auto";
+}
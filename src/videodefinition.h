@@ -10,6 +10,8 @@ public:
     static QList<int> getDefinitionCodes();
     static QHash<QString, int> getDefinitions();
     static int getDefinitionCode(QString name);
+    // the definition is chosen by measuring the network speed
+    static QString autoDefinitionName();
 
 };
 
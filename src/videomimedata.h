@@ -12,14 +12,20 @@ public:
     virtual QStringList formats() const;
     virtual bool hasFormat( const QString &mimeType ) const;
 
-    QList<Video*> videos() const { return m_videos; }
+    // the playlist may release a dragged video before it is dropped
+    QList<Video*> videos() const {
+        QList<Video*> videos;
+        foreach (Video *video, m_videos)
+            if (video) videos << video;
+        return videos;
+    }
 
     void addVideo(Video *video) {
-        m_videos << video;
+        m_videos << QPointer<Video>(video);
     }
 
 private:
-    QList<Video*> m_videos;
+    QList<QPointer<Video> > m_videos;
 
 };
 
@@ -2,41 +2,89 @@
 #include "youtubestreamreader.h"
 #include "constants.h"
 #include "networkaccess.h"
+#include "searchcache.h"
 
 namespace The {
     NetworkAccess* http();
+    SearchCache* searchCache();
 }
 
-YouTubeSearch::YouTubeSearch() : QObject() {}
+YouTubeSearch::YouTubeSearch() : QObject(), abortFlag(false), flushedVideos(0) {}
+
+YouTubeSearch::~YouTubeSearch() {
+    // pages nobody received yet
+    foreach (const QList<Video*> &videos, arrivedPages)
+        qDeleteAll(videos);
+}
 
 void YouTubeSearch::search(SearchParams *searchParams, int max, int skip) {
     this->abortFlag = false;
 
-    QString urlString = QString(
-            "http://gdata.youtube.com/feeds/api/videos?q=%1&max-results=%2&start-index=%3")
-            .arg(searchParams->keywords(), QString::number(max), QString::number(skip));
-
-    // Useful to test with a local webserver
-    /*
-    urlString = QString("http://localhost/oringo/video.xml?q=%1&max-results=%2&start-index=%3")
-                .arg(searchParams->keywords(), QString::number(max), QString::number(skip));
-                */
-
-    switch (searchParams->sortBy()) {
-    case SearchParams::SortByNewest:
-        urlString.append("&orderby=published");
-        break;
-    case SearchParams::SortByViewCount:
-        urlString.append("&orderby=viewCount");
-        break;
+    // a recent identical request is served from memory, no network roundtrip
+    const QString cacheKey = SearchCache::key(
+            searchParams->keywords(), searchParams->sortBy(), skip, max);
+    QList<Video*> cachedVideos;
+    if (The::searchCache()->page(cacheKey, cachedVideos)) {
+        pendingPages << skip;
+        arrivedPages.insert(skip, cachedVideos);
+        // deliver from the event loop as if it came from the network,
+        // callers may still be queuing more pages
+        QMetaObject::invokeMethod(this, "flushPages", Qt::QueuedConnection);
+        return;
     }
 
-    QUrl url(urlString);
+    QUrl url = searchUrl(searchParams->keywords(), searchParams->sortBy(), max, skip);
 
     QObject *reply = The::http()->get(url);
     connect(reply, SIGNAL(data(QByteArray)), SLOT(parseResults(QByteArray)));
     connect(reply, SIGNAL(error(QNetworkReply*)), SLOT(error(QNetworkReply*)));
 
+    // more pages can be requested concurrently,
+    // they will be delivered in order anyway
+    pendingPages << skip;
+    replyPages.insert(reply, skip);
+    replyCacheKeys.insert(reply, cacheKey);
+
+}
+
+void YouTubeSearch::prefetch(const QString &keywords, int sortBy, int max, int skip) {
+    const QString cacheKey = SearchCache::key(keywords, sortBy, skip, max);
+    if (cacheKey == prefetchKey || The::searchCache()->contains(cacheKey)) return;
+    for (int i = 0; i < prefetchQueue.size(); ++i)
+        if (prefetchQueue.at(i).first == cacheKey) return;
+
+    prefetchQueue << qMakePair(cacheKey, searchUrl(keywords, sortBy, max, skip));
+    if (!prefetchReply) prefetchNext();
+}
+
+void YouTubeSearch::prefetchNext() {
+    // a reply moves the queue once, whatever else it emits later
+    if (prefetchReply) prefetchReply->disconnect(this);
+    prefetchReply = 0;
+    prefetchKey.clear();
+    if (prefetchQueue.isEmpty()) return;
+
+    QPair<QString, QUrl> request = prefetchQueue.takeFirst();
+    prefetchKey = request.first;
+    prefetchReply = The::http()->get(request.second);
+    connect(prefetchReply, SIGNAL(data(QByteArray)), SLOT(prefetchResults(QByteArray)));
+    connect(prefetchReply, SIGNAL(error(QNetworkReply*)), SLOT(prefetchError()));
+}
+
+void YouTubeSearch::prefetchError() {
+    if (sender() != prefetchReply) return;
+    prefetchNext();
+}
+
+void YouTubeSearch::prefetchResults(QByteArray data) {
+    // late replies would be cached under the wrong key
+    if (sender() != prefetchReply) return;
+    YouTubeStreamReader reader;
+    if (reader.read(data))
+        The::searchCache()->insert(prefetchKey, reader.getVideos());
+    // the cache made its own copies
+    qDeleteAll(reader.getVideos());
+    prefetchNext();
 }
 
 void YouTubeSearch::error(QNetworkReply *reply) {
@@ -44,31 +92,68 @@ void YouTubeSearch::error(QNetworkReply *reply) {
 }
 
 void YouTubeSearch::parseResults(QByteArray data) {
+    const int page = replyPages.take(sender());
+    const QString cacheKey = replyCacheKeys.take(sender());
+    if (abortFlag) return;
 
     YouTubeStreamReader reader;
     if (!reader.read(data)) {
         qDebug() << "Error parsing XML";
+    } else {
+        The::searchCache()->insert(cacheKey, reader.getVideos());
     }
-    videos = reader.getVideos();
+    arrivedPages.insert(page, reader.getVideos());
 
-    foreach (Video *video, videos) {
-        // send it to the model
-        emit gotVideo(video);
-    }
+    flushPages();
+}
 
-    foreach (Video *video, videos) {
-        // preload the thumb
-        if (abortFlag) return;
-        video->preloadThumbnail();
+void YouTubeSearch::flushPages() {
+    if (abortFlag) return;
+    while (!pendingPages.isEmpty() && arrivedPages.contains(pendingPages.first())) {
+        QList<Video*> videos = arrivedPages.take(pendingPages.takeFirst());
+        flushedVideos += videos.size();
+
+        // send the whole page to the model at once
+        // thumbnails are loaded by the view as rows become visible
+        // the model owns the videos from now on
+        emit gotVideos(videos);
+
+        // report all the pages merged since the last time, not just the last one
+        if (pendingPages.isEmpty()) {
+            emit finished(flushedVideos);
+            flushedVideos = 0;
+        }
     }
-
-    emit finished(videos.size());
 }
 
-QList<Video*> YouTubeSearch::getResults() {
-    return videos;
+QUrl YouTubeSearch::searchUrl(const QString &keywords, int sortBy, int max, int skip) {
+    QString urlString = QString(
+            "http://gdata.youtube.com/feeds/api/videos?q=%1&max-results=%2&start-index=%3")
+            .arg(keywords, QString::number(max), QString::number(skip));
+
+    // Useful to test with a local webserver
+    /*
+    urlString = QString("http://localhost/oringo/video.xml?q=%1&max-results=%2&start-index=%3")
+                .arg(keywords, QString::number(max), QString::number(skip));
+                */
+
+    switch (sortBy) {
+    case SearchParams::SortByNewest:
+        urlString.append("&orderby=published");
+        break;
+    case SearchParams::SortByViewCount:
+        urlString.append("&orderby=viewCount");
+        break;
+    }
+
+    return QUrl(urlString);
 }
 
 void YouTubeSearch::abort() {
     this->abortFlag = true;
+    // nothing is going to be flushed anymore
+    foreach (const QList<Video*> &videos, arrivedPages)
+        qDeleteAll(videos);
+    arrivedPages.clear();
+    pendingPages.clear();
 }
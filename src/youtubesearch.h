@@ -10,24 +10,43 @@ class YouTubeSearch : public QObject {
 
 public:
     YouTubeSearch();
+    ~YouTubeSearch();
     void search(SearchParams *searchParams, int max, int skip);
+    void prefetch(const QString &keywords, int sortBy, int max, int skip);
     void abort();
-    QList<Video*> getResults();
 
 signals:
-    void gotVideo(Video*);
+    void gotVideos(QList<Video*>);
     void finished(int total);
     void error(QString message);
 
 private slots:
     void parseResults(QByteArray data);
     void error(QNetworkReply *reply);
+    void flushPages();
+    void prefetchResults(QByteArray data);
+    void prefetchError();
 
 private:
-
-    QList<Video*> videos;
+    static QUrl searchUrl(const QString &keywords, int sortBy, int max, int skip);
+    void prefetchNext();
 
     bool abortFlag;
+    // videos delivered since the last finished() signal
+    int flushedVideos;
+
+    // Start indexes of the pages still to be delivered, in request order.
+    // Pages can arrive out of order and are parked until their turn.
+    QList<int> pendingPages;
+    QHash<QObject*, int> replyPages;
+    QHash<QObject*, QString> replyCacheKeys;
+    QMap<int, QList<Video*> > arrivedPages;
+
+    // Speculative requests only feed the search cache.
+    // They run one at a time to leave bandwidth to the video stream.
+    QList<QPair<QString, QUrl> > prefetchQueue;
+    QPointer<QObject> prefetchReply;
+    QString prefetchKey;
 
 };
 
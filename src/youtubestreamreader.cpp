@@ -79,7 +79,9 @@ void YouTubeStreamReader::readEntry() {
                         if (name() == "thumbnail") {
                             // qDebug() << "Thumb: " << attributes().value("url").toString();
                             // video->thumbnailUrls() << QUrl(attributes().value("url").toString());
-                            video->addThumbnailUrl(QUrl(attributes().value("url").toString()));
+                            QSize size(attributes().value("width").toString().toInt(),
+                                       attributes().value("height").toString().toInt());
+                            video->addThumbnailUrl(QUrl(attributes().value("url").toString()), size);
                         }
                         else if (name() == "title") {
                             QString title = readElementText();